@@ -2189,6 +2189,8 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
+    if (ifilter->ist->unwanted_origin == AV_NOPTS_VALUE)
+        ifilter->ist->unwanted_origin = frame->pts;
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
@@ -2344,6 +2346,80 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     return err < 0 ? err : ret;
 }
 
+/*
+ * With -discard_unwanted, find the frame rate wanted by the filters fed by
+ * the stream once their graphs are configured. If it is at most half the
+ * stream frame rate, the decoder of an inter-coded stream is asked to skip
+ * the non-reference frames, and the packets of an intra-only stream are
+ * filtered by discard_unwanted_packet(). This is done each time a graph is
+ * (re)configured, starting again from the skip_frame value requested by
+ * the user, so that a graph which no longer drops frames gets them all.
+ */
+void setup_discard_unwanted(InputStream *ist)
+{
+    const AVCodecDescriptor *desc = avcodec_descriptor_get(ist->dec_ctx->codec_id);
+    AVRational wanted = { 0, 1 }, stream_rate = ist->st->avg_frame_rate;
+    int i;
+
+    if (!ist->discard_unwanted || !avcodec_is_open(ist->dec_ctx))
+        return;
+    ist->unwanted_rate       = (AVRational){ 0, 1 };
+    ist->unwanted_origin     = AV_NOPTS_VALUE;
+    ist->dec_ctx->skip_frame = ist->user_skip_frame;
+
+    /* with -r, the frames are timestamped by counting them */
+    if (ist->framerate.num || !ist->nb_filters)
+        return;
+    for (i = 0; i < ist->nb_filters; i++) {
+        AVRational rate;
+
+        if (!ist->filters[i]->filter)
+            return;
+        rate = av_buffersrc_get_wanted_frame_rate(ist->filters[i]->filter);
+        if (!rate.num)
+            return;
+        if (av_cmp_q(rate, wanted) > 0)
+            wanted = rate;
+    }
+    if (!stream_rate.num || !stream_rate.den ||
+        av_cmp_q(av_mul_q(wanted, (AVRational){ 2, 1 }), stream_rate) > 0)
+        return;
+
+    ist->unwanted_rate = wanted;
+    if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY))
+        ist->dec_ctx->skip_frame = FFMAX(ist->user_skip_frame, AVDISCARD_NONREF);
+}
+
+/*
+ * Tell if a packet of an intra-only stream can be discarded before decoding
+ * because the fps filter it feeds would drop the frame. Like that filter,
+ * only keep the last frame rounding to each output slot, the slots being
+ * counted from the first frame the filter received. The packet timestamps
+ * already include the input offsets, so they are in the base of the
+ * timestamps given to the buffer source.
+ */
+static int discard_unwanted_packet(InputStream *ist, const AVPacket *pkt)
+{
+    const AVCodecDescriptor *desc = avcodec_descriptor_get(ist->dec_ctx->codec_id);
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    int64_t duration = pkt->duration;
+    AVRational tb_wanted;
+
+    if (!ist->unwanted_rate.num || ist->nb_filters != 1 ||
+        ist->unwanted_origin == AV_NOPTS_VALUE ||
+        !desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY) ||
+        ts == AV_NOPTS_VALUE)
+        return 0;
+    if (duration <= 0)
+        duration = av_rescale_q(1, av_inv_q(ist->st->avg_frame_rate), ist->st->time_base);
+    ts -= ist->unwanted_origin;
+    if (ts <= 0)
+        return 0;
+    tb_wanted = av_inv_q(ist->unwanted_rate);
+    return av_rescale_q_rnd(ts,            ist->st->time_base, tb_wanted, AV_ROUND_NEAR_INF) ==
+           av_rescale_q_rnd(ts + duration, ist->st->time_base, tb_wanted, AV_ROUND_NEAR_INF);
+}
+
 static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_t *duration_pts, int eof,
                         int *decode_failed)
 {
@@ -2359,6 +2435,9 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     if (!eof && pkt && pkt->size == 0)
         return 0;
 
+    if (!eof && pkt && discard_unwanted_packet(ist, pkt))
+        return 0;
+
     if (!ist->decoded_frame && !(ist->decoded_frame = av_frame_alloc()))
         return AVERROR(ENOMEM);
     if (!ist->filter_frame && !(ist->filter_frame = av_frame_alloc()))
@@ -2945,6 +3024,7 @@ static int init_input_stream(int ist_index, char *error, int error_len)
             return ret;
         }
         assert_avoptions(ist->decoder_opts);
+        ist->user_skip_frame = ist->dec_ctx->skip_frame;
     }
 
     ist->next_pts = AV_NOPTS_VALUE;
@@ -133,6 +133,8 @@ typedef struct OptionsContext {
     int        nb_hwaccel_output_formats;
     SpecifierOpt *autorotate;
     int        nb_autorotate;
+    SpecifierOpt *discard_unwanted;
+    int        nb_discard_unwanted;
 
     /* output options */
     StreamMap *stream_maps;
@@ -335,6 +337,10 @@ typedef struct InputStream {
     int guess_layout_max;
 
     int autorotate;
+    int discard_unwanted;               /* skip the frames dropped by the filters */
+    AVRational unwanted_rate;           /* frame rate wanted by the filters, 0 if unknown */
+    int64_t unwanted_origin;            /* pts of the first frame sent to the filters */
+    enum AVDiscard user_skip_frame;     /* skip_frame requested for the decoder */
 
     int fix_sub_duration;
     struct { /* previous decoded subtitle and related variables */
@@ -611,6 +617,8 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_parallel;
+extern int filter_stats;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
@@ -641,6 +649,7 @@ enum AVPixelFormat choose_pixel_fmt(AVStream *st, AVCodecContext *avctx, AVCodec
 void choose_sample_fmt(AVStream *st, AVCodec *codec);
 
 int configure_filtergraph(FilterGraph *fg);
+void setup_discard_unwanted(InputStream *ist);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 void check_filter_outputs(void);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
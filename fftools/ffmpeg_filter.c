@@ -1043,6 +1043,9 @@ int configure_filtergraph(FilterGraph *fg)
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
+    if (filter_parallel)
+        fg->graph->thread_type |= AVFILTER_THREAD_GRAPH;
+    fg->graph->activation_stats = filter_stats;
 
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
@@ -1117,6 +1120,9 @@ int configure_filtergraph(FilterGraph *fg)
 
     fg->reconfiguration = 1;
 
+    for (i = 0; i < fg->nb_inputs; i++)
+        setup_discard_unwanted(fg->inputs[i]->ist);
+
     for (i = 0; i < fg->nb_outputs; i++) {
         OutputStream *ost = fg->outputs[i]->ost;
         if (!ost->enc) {
@@ -1137,6 +1143,8 @@ int configure_filtergraph(FilterGraph *fg)
         while (av_fifo_size(fg->inputs[i]->frame_queue)) {
             AVFrame *tmp;
             av_fifo_generic_read(fg->inputs[i]->frame_queue, &tmp, sizeof(tmp), NULL);
+            if (fg->inputs[i]->ist->unwanted_origin == AV_NOPTS_VALUE)
+                fg->inputs[i]->ist->unwanted_origin = tmp->pts;
             ret = av_buffersrc_add_frame(fg->inputs[i]->filter, tmp);
             av_frame_free(&tmp);
             if (ret < 0)
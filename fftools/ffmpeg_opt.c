@@ -109,6 +109,8 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int filter_parallel = 0;
+int filter_stats = 0;
 int vstats_version = 2;
 
 
@@ -730,6 +732,8 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
         ist->autorotate = 1;
         MATCH_PER_STREAM_OPT(autorotate, i, ist->autorotate, ic, st);
 
+        MATCH_PER_STREAM_OPT(discard_unwanted, i, ist->discard_unwanted, ic, st);
+
         MATCH_PER_STREAM_OPT(codec_tags, str, codec_tag, ic, st);
         if (codec_tag) {
             uint32_t tag = strtol(codec_tag, &next, 0);
@@ -3440,6 +3444,10 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_parallel", OPT_BOOL | OPT_EXPERT,                      { &filter_parallel },
+        "run independent filters of a filtergraph concurrently" },
+    { "filter_stats",   OPT_BOOL | OPT_EXPERT,                       { &filter_stats },
+        "print the activation statistics of the filters of each filtergraph" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -3567,6 +3575,9 @@ const OptionDef options[] = {
     { "autorotate",       HAS_ARG | OPT_BOOL | OPT_SPEC |
                           OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(autorotate) },
         "automatically insert correct rotate filters" },
+    { "discard_unwanted", OPT_VIDEO | OPT_BOOL | OPT_SPEC |
+                          OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(discard_unwanted) },
+        "do not decode the frames dropped by the filters" },
 
     /* audio options */
     { "aframes",        OPT_AUDIO | HAS_ARG  | OPT_PERFILE | OPT_OUTPUT,           { .func_arg = opt_audio_frames },
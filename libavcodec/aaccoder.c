@@ -392,9 +392,15 @@ static void search_for_quantizers_anmr(AVCodecContext *avctx, AACEncContext *s,
                 sce->sf_idx[(w+w2)*16+g] = sce->sf_idx[w*16+g];
 }
 
-static void search_for_quantizers_fast(AVCodecContext *avctx, AACEncContext *s,
-                                       SingleChannelElement *sce,
-                                       const float lambda)
+/**
+ * Two-loop quantizers search, the outer (quality improving) loop is run at
+ * most max_its times.
+ */
+static av_always_inline void search_for_quantizers_fast_template(AVCodecContext *avctx,
+                                                                 AACEncContext *s,
+                                                                 SingleChannelElement *sce,
+                                                                 const float lambda,
+                                                                 const int max_its)
 {
     int start = 0, i, w, w2, g;
     int destbits = avctx->bit_rate * 1024.0 / avctx->sample_rate / avctx->channels * (lambda / 120.f);
@@ -537,7 +543,26 @@ static void search_for_quantizers_fast(AVCodecContext *avctx, AACEncContext *s,
             }
         }
         its++;
-    } while (fflag && its < 10);
+    } while (fflag && its < max_its);
+}
+
+static void search_for_quantizers_fast(AVCodecContext *avctx, AACEncContext *s,
+                                       SingleChannelElement *sce,
+                                       const float lambda)
+{
+    search_for_quantizers_fast_template(avctx, s, sce, lambda, 10);
+}
+
+/**
+ * Single pass variant of search_for_quantizers_fast: the global quantizer is
+ * fitted to the bit budget once and every band gets a single greedy
+ * correction towards its masking threshold.
+ */
+static void search_for_quantizers_greedy(AVCodecContext *avctx, AACEncContext *s,
+                                         SingleChannelElement *sce,
+                                         const float lambda)
+{
+    search_for_quantizers_fast_template(avctx, s, sce, lambda, 1);
 }
 
 static void search_for_pns(AACEncContext *s, AVCodecContext *avctx, SingleChannelElement *sce)
@@ -961,4 +986,26 @@ const AACCoefficientsEncoder ff_aac_coders[AAC_CODER_NB] = {
         ff_aac_search_for_is,
         ff_aac_search_for_pred,
     },
+    [AAC_CODER_GREEDY] = {
+        search_for_quantizers_greedy,
+        codebook_greedy_rate,
+        quantize_and_encode_band,
+        ff_aac_encode_tns_info,
+        ff_aac_encode_ltp_info,
+        ff_aac_encode_main_pred,
+        ff_aac_adjust_common_pred,
+        ff_aac_adjust_common_ltp,
+        ff_aac_apply_main_pred,
+        ff_aac_apply_tns,
+        ff_aac_update_ltp,
+        ff_aac_ltp_insert_new_frame,
+        set_special_band_scalefactors,
+        search_for_pns,
+        mark_pns,
+        ff_aac_search_for_tns,
+        ff_aac_search_for_ltp,
+        search_for_ms,
+        ff_aac_search_for_is,
+        ff_aac_search_for_pred,
+    },
 };
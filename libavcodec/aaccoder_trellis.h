@@ -26,7 +26,8 @@
  */
 
 /**
- * This file contains a template for the codebook_trellis_rate selector function.
+ * This file contains a template for the codebook_trellis_rate and
+ * codebook_greedy_rate selector functions.
  * It needs to be provided, externally, as an already included declaration,
  * the following functions from aacenc_quantization/util.h. They're not included
  * explicitly here to make it possible to provide alternative implementations:
@@ -56,8 +57,16 @@ typedef struct TrellisBandCodingPath {
 } TrellisBandCodingPath;
 
 
-static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
-                                  int win, int group_len, const float lambda)
+/**
+ * Select codebooks and encode band info for a single window group.
+ *
+ * @param cb_span number of codebooks tried for every band, starting from the
+ *                smallest one able to represent it
+ */
+static av_always_inline void codebook_rate_template(AACEncContext *s,
+                                                    SingleChannelElement *sce,
+                                                    int win, int group_len,
+                                                    const int cb_span)
 {
     TrellisBandCodingPath path[120][CB_TOT_ALL];
     int w, swb, cb, start, size;
@@ -105,7 +114,9 @@ static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
             float minbits = next_minbits;
             int mincb = next_mincb;
             int startcb = sce->band_type[win*16+swb];
+            int endcb;
             startcb = aac_cb_in_map[startcb];
+            endcb   = FFMIN(startcb + cb_span, CB_TOT_ALL);
             next_minbits = INFINITY;
             next_mincb = 0;
             for (cb = 0; cb < startcb; cb++) {
@@ -113,7 +124,12 @@ static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
                 path[swb+1][cb].prev_idx = -1;
                 path[swb+1][cb].run = 0;
             }
-            for (cb = startcb; cb < CB_TOT_ALL; cb++) {
+            for (cb = endcb; cb < CB_TOT_ALL; cb++) {
+                path[swb+1][cb].cost = 61450;
+                path[swb+1][cb].prev_idx = -1;
+                path[swb+1][cb].run = 0;
+            }
+            for (cb = startcb; cb < endcb; cb++) {
                 float cost_stay_here, cost_get_here;
                 float bits = 0.0f;
                 if (cb >= 12 && sce->band_type[win*16+swb] != aac_cb_out_map[cb]) {
@@ -188,5 +204,21 @@ static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
     }
 }
 
+static void codebook_trellis_rate(AACEncContext *s, SingleChannelElement *sce,
+                                  int win, int group_len, const float lambda)
+{
+    codebook_rate_template(s, sce, win, group_len, CB_TOT_ALL);
+}
+
+/**
+ * Cheaper variant of codebook_trellis_rate, only the two codebooks following
+ * the smallest usable one are considered for every band.
+ */
+static void codebook_greedy_rate(AACEncContext *s, SingleChannelElement *sce,
+                                 int win, int group_len, const float lambda)
+{
+    codebook_rate_template(s, sce, win, group_len, 3);
+}
+
 
 #endif /* AVCODEC_AACCODER_TRELLIS_H */
@@ -36,6 +36,7 @@ typedef enum AACCoder {
     AAC_CODER_ANMR = 0,
     AAC_CODER_TWOLOOP,
     AAC_CODER_FAST,
+    AAC_CODER_GREEDY,
 
     AAC_CODER_NB,
 }AACCoder;
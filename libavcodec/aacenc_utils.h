@@ -66,14 +66,14 @@ static inline void quantize_bands(int *out, const float *in, const float *scaled
                                   int size, int is_signed, int maxval, const float Q34,
                                   const float rounding)
 {
+    const int sign_mask = is_signed ? -1 : 0;
     int i;
     for (i = 0; i < size; i++) {
         float qc = scaled[i] * Q34;
-        int tmp = (int)FFMIN(qc + rounding, (float)maxval);
-        if (is_signed && in[i] < 0.0f) {
-            tmp = -tmp;
-        }
-        out[i] = tmp;
+        int tmp  = (int)FFMIN(qc + rounding, (float)maxval);
+        /* branchless conditional negation, the sign of in[i] is unpredictable */
+        int sign = -(in[i] < 0.0f) & sign_mask;
+        out[i] = (tmp ^ sign) - sign;
     }
 }
 
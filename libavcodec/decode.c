@@ -252,6 +252,16 @@ fail:
     return ret;
 }
 
+/* reset the filter chain state while keeping the filters initialized */
+static void bsfs_flush(AVCodecContext *avctx)
+{
+    DecodeFilterContext *s = &avctx->internal->filter;
+    int i;
+
+    for (i = 0; i < s->nb_bsfs; i++)
+        av_bsf_flush(s->bsfs[i]);
+}
+
 /* try to get one output packet from the filter chain */
 static int bsfs_poll(AVCodecContext *avctx, AVPacket *pkt)
 {
@@ -1963,7 +1973,7 @@ void avcodec_flush_buffers(AVCodecContext *avctx)
     avctx->pts_correction_last_pts =
     avctx->pts_correction_last_dts = INT64_MIN;
 
-    ff_decode_bsfs_uninit(avctx);
+    bsfs_flush(avctx);
 
     if (!avctx->refcounted_frames)
         av_frame_unref(avctx->internal->to_free);
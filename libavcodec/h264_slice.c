@@ -1035,7 +1035,14 @@ static int h264_init_ps(H264Context *h, const H264SliceContext *sl, int first_sl
         if (h->bit_depth_luma    != h->ps.sps->bit_depth_luma ||
             h->chroma_format_idc != h->ps.sps->chroma_format_idc)
             needs_reinit         = 1;
+
+        /* a new SPS after a seek gets a full reinit, like before the
+         * tables were kept across flushes */
+        if (h->flushed)
+            needs_reinit = 1;
     }
+    if (first_slice)
+        h->flushed = 0;
     sps = h->ps.sps;
 
     must_reinit = (h->context_initialized &&
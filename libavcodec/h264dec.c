@@ -505,7 +505,9 @@ void ff_h264_flush_change(H264Context *h)
     h->mmco_reset = 1;
 }
 
-/* forget old pics after a seek */
+/* forget old pics after a seek
+ * tables, pools and the pixel format are kept if the stream continues with
+ * the same SPS, h264_init_ps() reinitializes the context otherwise */
 static void flush_dpb(AVCodecContext *avctx)
 {
     H264Context *h = avctx->priv_data;
@@ -522,9 +524,7 @@ static void flush_dpb(AVCodecContext *avctx)
     ff_h264_unref_picture(h, &h->cur_pic);
 
     h->mb_y = 0;
-
-    ff_h264_free_tables(h);
-    h->context_initialized = 0;
+    h->flushed = 1;
 }
 
 static int get_last_needed_nal(H264Context *h)
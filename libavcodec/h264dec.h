@@ -363,6 +363,7 @@ typedef struct H264Context {
     int coded_picture_number;
 
     int context_initialized;
+    int flushed;    ///< set by a flush, the context is reinitialized if the next SPS differs
     int flags;
     int workaround_bugs;
     int x264_build;
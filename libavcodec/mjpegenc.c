@@ -33,11 +33,17 @@
 #include "libavutil/pixdesc.h"
 
 #include "avcodec.h"
+#include "fdctdsp.h"
+#include "internal.h"
 #include "jpegtables.h"
 #include "mjpegenc_common.h"
+#include "mpeg12data.h"
+#include "mpegutils.h"
 #include "mpegvideo.h"
+#include "mpegvideodata.h"
 #include "mjpeg.h"
 #include "mjpegenc.h"
+#include "pixblockdsp.h"
 
 static int alloc_huffman(MpegEncContext *s)
 {
@@ -267,9 +273,9 @@ static void encode_block(MpegEncContext *s, int16_t *block, int n)
             nbits= av_log2_16bit(val) + 1;
             code = (run << 4) | nbits;
 
-            put_bits(&s->pb, huff_size_ac[code], huff_code_ac[code]);
-
-            put_sbits(&s->pb, nbits, mant);
+            /* code and mantissa fit in a single write (at most 16 + 11 bits) */
+            put_bits(&s->pb, huff_size_ac[code] + nbits,
+                     (huff_code_ac[code] << nbits) | av_mod_uintp2(mant, nbits));
             run = 0;
         }
     }
@@ -345,6 +351,266 @@ void ff_mjpeg_encode_mb(MpegEncContext *s, int16_t block[12][64])
     }
 }
 
+#if CONFIG_MJPEG_ENCODER
+/*
+ * Lightweight baseline path: every frame is intra coded with a constant
+ * quantizer, so the mpegvideo machinery (picture buffers, rate control,
+ * motion estimation setup, slice contexts) is bypassed. Only the DCT,
+ * quantizer and Huffman tables of the MpegEncContext are used.
+ */
+static av_cold int mjpeg_fast_init(AVCodecContext *avctx)
+{
+    MpegEncContext *s = avctx->priv_data;
+    int ret;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        av_log(avctx, AV_LOG_ERROR,
+               "The fast MJPEG path does not support slice threading, "
+               "use frame threading instead.\n");
+        return AVERROR(ENOSYS);
+    }
+    if (avctx->trellis) {
+        av_log(avctx, AV_LOG_ERROR,
+               "The fast MJPEG path does not support trellis quantization.\n");
+        return AVERROR(EINVAL);
+    }
+    if (!(avctx->flags & AV_CODEC_FLAG_QSCALE) ||
+        avctx->rc_max_rate || avctx->rc_buffer_size) {
+        av_log(avctx, AV_LOG_ERROR,
+               "The fast MJPEG path has no rate control, set a constant "
+               "quantizer with global_quality (-q:v) instead of a bitrate.\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->avctx     = avctx;
+    s->width     = avctx->width;
+    s->height    = avctx->height;
+    s->mb_width  = (s->width  + 15) / 16;
+    s->mb_height = (s->height + 15) / 16;
+    switch (avctx->pix_fmt) {
+    case AV_PIX_FMT_YUVJ444P: s->chroma_format = CHROMA_444; break;
+    case AV_PIX_FMT_YUVJ422P: s->chroma_format = CHROMA_422; break;
+    default:                  s->chroma_format = CHROMA_420; break;
+    }
+    av_pix_fmt_get_chroma_sub_sample(avctx->pix_fmt, &s->chroma_x_shift,
+                                     &s->chroma_y_shift);
+
+    s->out_format         = FMT_MJPEG;
+    s->mb_intra           = 1;
+    s->intra_dc_precision = 0;
+    s->slice_context_count = 1;
+    if (s->intra_quant_bias == FF_DEFAULT_QUANT_BIAS)
+        s->intra_quant_bias = 3 << (8 - 3);
+
+    ret = ff_mjpeg_encode_init(s);
+    if (ret < 0)
+        return ret;
+
+    ff_fdctdsp_init(&s->fdsp, avctx);
+    ff_pixblockdsp_init(&s->pdsp, avctx);
+    ff_init_scantable_permutation(s->idsp.idct_permutation, FF_IDCT_PERM_NONE);
+    s->idsp.perm_type = FF_IDCT_PERM_NONE;
+    ff_init_scantable(s->idsp.idct_permutation, &s->intra_scantable,
+                      ff_zigzag_direct);
+    ff_dct_encode_init(s);
+
+    FF_ALLOCZ_OR_GOTO(avctx, s->q_intra_matrix,          64 * 32 * sizeof(int),          fail);
+    FF_ALLOCZ_OR_GOTO(avctx, s->q_chroma_intra_matrix,   64 * 32 * sizeof(int),          fail);
+    FF_ALLOCZ_OR_GOTO(avctx, s->q_intra_matrix16,        64 * 32 * 2 * sizeof(uint16_t), fail);
+    FF_ALLOCZ_OR_GOTO(avctx, s->q_chroma_intra_matrix16, 64 * 32 * 2 * sizeof(uint16_t), fail);
+    FF_ALLOCZ_OR_GOTO(avctx, s->blocks, 12 * 64 * sizeof(int16_t), fail);
+    s->block  = s->blocks[0];
+    s->qscale = 0;
+
+    return 0;
+fail:
+    return AVERROR(ENOMEM);
+}
+
+static av_cold int mjpeg_fast_close(AVCodecContext *avctx)
+{
+    MpegEncContext *s = avctx->priv_data;
+
+    if (s->mjpeg_ctx)
+        ff_mjpeg_encode_close(s);
+    av_freep(&s->q_intra_matrix);
+    av_freep(&s->q_chroma_intra_matrix);
+    av_freep(&s->q_intra_matrix16);
+    av_freep(&s->q_chroma_intra_matrix16);
+    av_freep(&s->blocks);
+    s->block = NULL;
+    return 0;
+}
+
+static void mjpeg_fast_update_matrices(MpegEncContext *s, int qscale)
+{
+    const uint16_t *  luma_matrix = ff_mpeg1_default_intra_matrix;
+    const uint16_t *chroma_matrix = ff_mpeg1_default_intra_matrix;
+    int i;
+
+    if (s->avctx->intra_matrix) {
+        chroma_matrix =
+        luma_matrix = s->avctx->intra_matrix;
+    }
+    if (s->avctx->chroma_intra_matrix)
+        chroma_matrix = s->avctx->chroma_intra_matrix;
+
+    /* same scaling as the mpegvideo path, the qscale is part of the matrix */
+    for (i = 1; i < 64; i++) {
+        s->chroma_intra_matrix[i] = av_clip_uint8((chroma_matrix[i] * qscale) >> 3);
+        s->       intra_matrix[i] = av_clip_uint8((  luma_matrix[i] * qscale) >> 3);
+    }
+    s->y_dc_scale = s->c_dc_scale = ff_mpeg2_dc_scale_table[0][8];
+    s->chroma_intra_matrix[0] =
+    s->intra_matrix[0]        = ff_mpeg2_dc_scale_table[0][8];
+    ff_convert_matrix(s, s->q_intra_matrix, s->q_intra_matrix16,
+                      s->intra_matrix, s->intra_quant_bias, 8, 8, 1);
+    ff_convert_matrix(s, s->q_chroma_intra_matrix, s->q_chroma_intra_matrix16,
+                      s->chroma_intra_matrix, s->intra_quant_bias, 8, 8, 1);
+    s->qscale = qscale;
+}
+
+static void mjpeg_fast_get_block(MpegEncContext *s, int16_t *block,
+                                 const uint8_t *src, ptrdiff_t linesize,
+                                 int x, int y, int w, int h)
+{
+    int i, j;
+
+    if (x + 8 <= w && y + 8 <= h) {
+        s->pdsp.get_pixels(block, src + y * linesize + x, linesize);
+        return;
+    }
+    /* replicate the picture edges into partial blocks */
+    for (i = 0; i < 8; i++) {
+        const uint8_t *row = src + FFMIN(y + i, h - 1) * linesize;
+        for (j = 0; j < 8; j++)
+            block[i * 8 + j] = row[FFMIN(x + j, w - 1)];
+    }
+}
+
+static void mjpeg_fast_encode_mb(MpegEncContext *s, const AVFrame *pic,
+                                 int mb_x, int mb_y)
+{
+    const int cw = AV_CEIL_RSHIFT(s->width,  s->chroma_x_shift);
+    const int ch = AV_CEIL_RSHIFT(s->height, s->chroma_y_shift);
+    const int cx = (mb_x * 16) >> s->chroma_x_shift;
+    const int cy = (mb_y * 16) >> s->chroma_y_shift;
+    int i, nb_blocks = 6, overflow;
+
+    for (i = 0; i < 4; i++)
+        mjpeg_fast_get_block(s, s->block[i], pic->data[0], pic->linesize[0],
+                             mb_x * 16 + (i & 1) * 8, mb_y * 16 + (i >> 1) * 8,
+                             s->width, s->height);
+
+    mjpeg_fast_get_block(s, s->block[4], pic->data[1], pic->linesize[1],
+                         cx, cy, cw, ch);
+    mjpeg_fast_get_block(s, s->block[5], pic->data[2], pic->linesize[2],
+                         cx, cy, cw, ch);
+    if (s->chroma_format == CHROMA_422) {
+        mjpeg_fast_get_block(s, s->block[6], pic->data[1], pic->linesize[1],
+                             cx, cy + 8, cw, ch);
+        mjpeg_fast_get_block(s, s->block[7], pic->data[2], pic->linesize[2],
+                             cx, cy + 8, cw, ch);
+        nb_blocks = 8;
+    } else if (s->chroma_format == CHROMA_444) {
+        for (i = 6; i < 12; i++)
+            mjpeg_fast_get_block(s, s->block[i], pic->data[1 + (i & 1)],
+                                 pic->linesize[1 + (i & 1)],
+                                 cx + ((i - 4) & 2) * 4, cy + ((i - 4) & 4) * 2,
+                                 cw, ch);
+        nb_blocks = 12;
+    }
+
+    for (i = 0; i < nb_blocks; i++) {
+        int16_t *block = s->block[i];
+        s->block_last_index[i] = s->fast_dct_quantize(s, block, i, 8, &overflow);
+        if (overflow) {
+            int j;
+            for (j = 1; j < 64; j++)
+                block[j] = av_clip(block[j], s->min_qcoeff, s->max_qcoeff);
+        }
+    }
+
+    ff_mjpeg_encode_mb(s, s->block);
+}
+
+static int mjpeg_fast_encode_picture(AVCodecContext *avctx, AVPacket *pkt,
+                                     const AVFrame *pic, int *got_packet)
+{
+    MpegEncContext *s = avctx->priv_data;
+    int quality = pic->quality ? pic->quality : avctx->global_quality;
+    int qscale  = av_clip((quality + FF_QP2LAMBDA / 2) / FF_QP2LAMBDA,
+                          avctx->qmin, avctx->qmax);
+    int mb_x, mb_y, i, ret;
+
+    ret = ff_alloc_packet2(avctx, pkt,
+                           s->mb_width * s->mb_height * (MAX_MB_BYTES + 100) + 10000, 0);
+    if (ret < 0)
+        return ret;
+
+    if (qscale != s->qscale)
+        mjpeg_fast_update_matrices(s, qscale);
+
+    init_put_bits(&s->pb, pkt->data, pkt->size);
+    s->last_bits = 0;
+    if (s->huffman != HUFFMAN_TABLE_OPTIMAL)
+        ff_mjpeg_encode_picture_header(avctx, &s->pb, &s->intra_scantable,
+                                       0, s->intra_matrix, s->chroma_intra_matrix);
+    s->header_bits = get_bits_diff(s);
+
+    for (i = 0; i < 3; i++)
+        s->last_dc[i] = 128;
+
+    for (mb_y = 0; mb_y < s->mb_height; mb_y++)
+        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
+            s->mb_x = mb_x;
+            s->mb_y = mb_y;
+            mjpeg_fast_encode_mb(s, pic, mb_x, mb_y);
+        }
+
+    s->mb_x = 0;
+    s->mb_y = s->mb_height;
+    ret = ff_mjpeg_encode_stuffing(s);
+    if (ret < 0)
+        return ret;
+    ff_mjpeg_encode_picture_trailer(&s->pb, s->header_bits);
+    flush_put_bits(&s->pb);
+
+    pkt->size   = put_bits_count(&s->pb) >> 3;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+    *got_packet = 1;
+    return 0;
+}
+
+static av_cold int mjpeg_encode_init(AVCodecContext *avctx)
+{
+    MpegEncContext *s = avctx->priv_data;
+
+    if (s->mjpeg_fast)
+        return mjpeg_fast_init(avctx);
+    return ff_mpv_encode_init(avctx);
+}
+
+static int mjpeg_encode_picture(AVCodecContext *avctx, AVPacket *pkt,
+                                const AVFrame *pic, int *got_packet)
+{
+    MpegEncContext *s = avctx->priv_data;
+
+    if (s->mjpeg_fast)
+        return mjpeg_fast_encode_picture(avctx, pkt, pic, got_packet);
+    return ff_mpv_encode_picture(avctx, pkt, pic, got_packet);
+}
+
+static av_cold int mjpeg_encode_close(AVCodecContext *avctx)
+{
+    MpegEncContext *s = avctx->priv_data;
+
+    if (s->mjpeg_fast)
+        return mjpeg_fast_close(avctx);
+    return ff_mpv_encode_end(avctx);
+}
+#endif
+
 #if CONFIG_AMV_ENCODER
 // maximum over s->mjpeg_vsample[i]
 #define V_MAX 2
@@ -384,23 +650,27 @@ static int amv_encode_picture(AVCodecContext *avctx, AVPacket *pkt,
 
 #define OFFSET(x) offsetof(MpegEncContext, x)
 #define VE AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
-static const AVOption options[] = {
-FF_MPV_COMMON_OPTS
-{ "pred", "Prediction method", OFFSET(pred), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 3, VE, "pred" },
-    { "left",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 1 }, INT_MIN, INT_MAX, VE, "pred" },
-    { "plane",  NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 2 }, INT_MIN, INT_MAX, VE, "pred" },
-    { "median", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 3 }, INT_MIN, INT_MAX, VE, "pred" },
-{ "huffman", "Huffman table strategy", OFFSET(huffman), AV_OPT_TYPE_INT, { .i64 = HUFFMAN_TABLE_OPTIMAL }, 0, NB_HUFFMAN_TABLE_OPTION - 1, VE, "huffman" },
-    { "default", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = HUFFMAN_TABLE_DEFAULT }, INT_MIN, INT_MAX, VE, "huffman" },
+#define COMMON_OPTIONS \
+FF_MPV_COMMON_OPTS \
+{ "pred", "Prediction method", OFFSET(pred), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 3, VE, "pred" }, \
+    { "left",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 1 }, INT_MIN, INT_MAX, VE, "pred" }, \
+    { "plane",  NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 2 }, INT_MIN, INT_MAX, VE, "pred" }, \
+    { "median", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = 3 }, INT_MIN, INT_MAX, VE, "pred" }, \
+{ "huffman", "Huffman table strategy", OFFSET(huffman), AV_OPT_TYPE_INT, { .i64 = HUFFMAN_TABLE_OPTIMAL }, 0, NB_HUFFMAN_TABLE_OPTION - 1, VE, "huffman" }, \
+    { "default", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = HUFFMAN_TABLE_DEFAULT }, INT_MIN, INT_MAX, VE, "huffman" }, \
     { "optimal", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = HUFFMAN_TABLE_OPTIMAL }, INT_MIN, INT_MAX, VE, "huffman" },
+
+#if CONFIG_MJPEG_ENCODER
+static const AVOption mjpeg_options[] = {
+COMMON_OPTIONS
+{ "fast", "Use the lightweight intra-only path with a constant quantizer", OFFSET(mjpeg_fast), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
 { NULL},
 };
 
-#if CONFIG_MJPEG_ENCODER
 static const AVClass mjpeg_class = {
     .class_name = "mjpeg encoder",
     .item_name  = av_default_item_name,
-    .option     = options,
+    .option     = mjpeg_options,
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
@@ -410,9 +680,9 @@ AVCodec ff_mjpeg_encoder = {
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_MJPEG,
     .priv_data_size = sizeof(MpegEncContext),
-    .init           = ff_mpv_encode_init,
-    .encode2        = ff_mpv_encode_picture,
-    .close          = ff_mpv_encode_end,
+    .init           = mjpeg_encode_init,
+    .encode2        = mjpeg_encode_picture,
+    .close          = mjpeg_encode_close,
     .capabilities   = AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ444P, AV_PIX_FMT_NONE
@@ -422,10 +692,15 @@ AVCodec ff_mjpeg_encoder = {
 #endif
 
 #if CONFIG_AMV_ENCODER
+static const AVOption amv_options[] = {
+COMMON_OPTIONS
+{ NULL},
+};
+
 static const AVClass amv_class = {
     .class_name = "amv encoder",
     .item_name  = av_default_item_name,
-    .option     = options,
+    .option     = amv_options,
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
@@ -607,8 +607,7 @@ void ff_mjpeg_encode_dc(PutBitContext *pb, int val,
 
         nbits= av_log2_16bit(val) + 1;
 
-        put_bits(pb, huff_size[nbits], huff_code[nbits]);
-
-        put_sbits(pb, nbits, mant);
+        put_bits(pb, huff_size[nbits] + nbits,
+                 (huff_code[nbits] << nbits) | av_mod_uintp2(mant, nbits));
     }
 }
@@ -420,6 +420,7 @@ typedef struct MpegEncContext {
     int esc_pos;
     int pred;
     int huffman;
+    int mjpeg_fast;               ///< use the lightweight intra-only encoding path
 
     /* MSMPEG4 specific */
     int mv_table_index;
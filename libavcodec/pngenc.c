@@ -45,6 +45,18 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGEncSlice {
+    z_stream zstream;            ///< raw deflate stream for this band of rows
+    uint8_t *buf;                ///< compressed data of this band
+    unsigned int buf_size;
+    int size;                    ///< number of valid bytes in buf
+    uint8_t *crow_base;
+    unsigned int crow_size;
+    uLong adler;                 ///< adler32 of the uncompressed band
+    uLong in_size;               ///< uncompressed size of the band
+    int ret;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -57,6 +69,11 @@ typedef struct PNGEncContext {
 
     z_stream zstream;
     uint8_t buf[IOBUF_SIZE];
+    int compression_level;
+
+    PNGEncSlice *slices;
+    int nb_slices;
+
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -136,12 +153,7 @@ static void sub_png_paeth_prediction(uint8_t *dst, uint8_t *src, uint8_t *top,
         pb = abs(pc);
         pc = abs(p + pc);
 
-        if (pa <= pb && pa <= pc)
-            p = a;
-        else if (pb <= pc)
-            p = b;
-        else
-            p = c;
+        p = (pa <= pb && pa <= pc) ? a : pb <= pc ? b : c;
         dst[i] = src[i] - p;
     }
 }
@@ -191,6 +203,23 @@ static void png_filter_row(PNGEncContext *c, uint8_t *dst, int filter_type,
     }
 }
 
+/* Sum of absolute values of a filtered row, stopping early once it can no
+ * longer beat the best cost found so far. Blocks keep the inner loop simple
+ * enough for the compiler to vectorize. */
+static int png_filter_cost(const uint8_t *buf, int size, int bcost)
+{
+    int i, j, cost = 0;
+
+    for (i = 0; i < size && cost < bcost; i += 256) {
+        int block = FFMIN(size - i, 256);
+        int sum   = 0;
+        for (j = 0; j < block; j++)
+            sum += abs((int8_t) buf[i + j]);
+        cost += sum;
+    }
+    return cost;
+}
+
 static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
                                   uint8_t *src, uint8_t *top, int size, int bpp)
 {
@@ -199,15 +228,12 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
     if (!top && pred)
         pred = PNG_FILTER_VALUE_SUB;
     if (pred == PNG_FILTER_VALUE_MIXED) {
-        int i;
         int cost, bcost = INT_MAX;
         uint8_t *buf1 = dst, *buf2 = dst + size + 16;
         for (pred = 0; pred < 5; pred++) {
             png_filter_row(s, buf1 + 1, pred, src, top, size, bpp);
             buf1[0] = pred;
-            cost = 0;
-            for (i = 0; i <= size; i++)
-                cost += abs((int8_t) buf1[i]);
+            cost = png_filter_cost(buf1, size + 1, bcost);
             if (cost < bcost) {
                 bcost = cost;
                 FFSWAP(uint8_t *, buf1, buf2);
@@ -428,6 +454,105 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+static int png_encode_band(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s    = avctx->priv_data;
+    const AVFrame *pict = arg;
+    PNGEncSlice *sl     = &s->slices[jobnr];
+    int row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
+    int y_start  = pict->height *  jobnr      / s->nb_slices;
+    int y_end    = pict->height * (jobnr + 1) / s->nb_slices;
+    int last     = jobnr == s->nb_slices - 1;
+    /* room for the zlib header in the first band and adler32 in the last */
+    int prefix   = jobnr ? 0 : 2;
+    int suffix   = last  ? 4 : 0;
+    uint8_t *ptr, *top, *crow_buf, *crow;
+    int y, ret;
+
+    sl->ret     = AVERROR(ENOMEM);
+    sl->in_size = (uLong)(y_end - y_start) * (row_size + 1);
+    av_fast_malloc(&sl->crow_base, &sl->crow_size,
+                   (row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    av_fast_malloc(&sl->buf, &sl->buf_size,
+                   prefix + deflateBound(&sl->zstream, sl->in_size) + 16 + suffix);
+    if (!sl->crow_base || !sl->buf)
+        return sl->ret;
+    // pixel data should be aligned, but there's a control byte before it
+    crow_buf = sl->crow_base + 15;
+
+    sl->ret   = AVERROR_EXTERNAL;
+    sl->adler = adler32(0, NULL, 0);
+    deflateReset(&sl->zstream);
+    sl->zstream.next_out  = sl->buf + prefix;
+    sl->zstream.avail_out = sl->buf_size - prefix - suffix;
+
+    top = y_start ? pict->data[0] + (y_start - 1) * pict->linesize[0] : NULL;
+    for (y = y_start; y < y_end; y++) {
+        ptr  = pict->data[0] + y * pict->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top,
+                                 row_size, s->bits_per_pixel >> 3);
+        sl->adler = adler32(sl->adler, crow, row_size + 1);
+        sl->zstream.next_in  = crow;
+        sl->zstream.avail_in = row_size + 1;
+        if (deflate(&sl->zstream, Z_NO_FLUSH) != Z_OK || sl->zstream.avail_in)
+            return sl->ret;
+        top = ptr;
+    }
+    /* byte-align every band but the last so the raw streams concatenate */
+    ret = deflate(&sl->zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (last ? Z_STREAM_END : Z_OK))
+        return sl->ret;
+    sl->size = sl->zstream.next_out - sl->buf;
+
+    sl->ret = 0;
+    return 0;
+}
+
+/* Filter and compress horizontal bands of the image in parallel, then stitch
+ * the raw deflate streams into a single zlib stream. */
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncSlice *last = &s->slices[s->nb_slices - 1];
+    int level = s->compression_level == Z_DEFAULT_COMPRESSION ? 6 : s->compression_level;
+    unsigned header;
+    uLong adler;
+    int i;
+
+    avctx->execute2(avctx, png_encode_band, (void *)pict, NULL, s->nb_slices);
+
+    adler = s->slices[0].adler;
+    for (i = 0; i < s->nb_slices; i++) {
+        if (s->slices[i].ret < 0)
+            return s->slices[i].ret;
+        if (i)
+            adler = adler32_combine(adler, s->slices[i].adler, s->slices[i].in_size);
+    }
+
+    /* zlib header as deflateInit2() would write it for a 32K window */
+    header  = 0x78 << 8;
+    header |= (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    header += 31 - header % 31;
+    AV_WB16(s->slices[0].buf, header);
+    AV_WB32(last->buf + last->size, adler);
+    last->size += 4;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        const uint8_t *buf = s->slices[i].buf;
+        int left = s->slices[i].size;
+        while (left > 0) {
+            int len = FFMIN(left, IOBUF_SIZE);
+            if (s->bytestream_end - s->bytestream <= len + 100)
+                return AVERROR(ENOMEM);
+            png_write_image_data(avctx, buf, len);
+            buf  += len;
+            left -= len;
+        }
+    }
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -439,6 +564,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
 
+    if (s->nb_slices > 1 && !s->is_progressive && pict->height >= s->nb_slices)
+        return encode_frame_slices(avctx, pict);
+
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
@@ -989,7 +1117,7 @@ static int encode_apng(AVCodecContext *avctx, AVPacket *pkt,
 static av_cold int png_enc_init(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
-    int compression_level;
+    int compression_level, i;
 
     switch (avctx->pix_fmt) {
     case AV_PIX_FMT_RGBA:
@@ -1091,6 +1219,23 @@ FF_ENABLE_DEPRECATION_WARNINGS
                       : av_clip(avctx->compression_level, 0, 9);
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
+    s->compression_level = compression_level;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        s->slices = av_mallocz_array(avctx->thread_count, sizeof(*s->slices));
+        if (!s->slices)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < avctx->thread_count; i++) {
+            PNGEncSlice *sl = &s->slices[i];
+            sl->zstream.zalloc = ff_png_zalloc;
+            sl->zstream.zfree  = ff_png_zfree;
+            sl->zstream.opaque = NULL;
+            if (deflateInit2(&sl->zstream, compression_level, Z_DEFLATED, -15, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+            s->nb_slices++;
+        }
+    }
 
     return 0;
 }
@@ -1098,8 +1243,16 @@ FF_ENABLE_DEPRECATION_WARNINGS
 static av_cold int png_enc_close(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
+    int i;
 
     deflateEnd(&s->zstream);
+    for (i = 0; i < s->nb_slices; i++) {
+        deflateEnd(&s->slices[i].zstream);
+        av_freep(&s->slices[i].buf);
+        av_freep(&s->slices[i].crow_base);
+    }
+    av_freep(&s->slices);
+    s->nb_slices = 0;
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1146,7 +1299,8 @@ AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdarg.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/buffer.h"
@@ -190,9 +192,37 @@ int avfilter_link_get_channels(AVFilterLink *link)
 }
 #endif
 
+/**
+ * Filters activated concurrently are never linked together, but they may
+ * share a neighbour whose state they both update.
+ */
+static void neighbour_lock(AVFilterContext *filter, int lock)
+{
+    AVFilterGraphInternal *gi = filter->graph ? filter->graph->internal : NULL;
+
+    if (gi && gi->sched_busy) {
+        if (lock)
+            ff_mutex_lock(&gi->sched_lock);
+        else
+            ff_mutex_unlock(&gi->sched_lock);
+    }
+}
+
+static int link_blocked_in(AVFilterLink *link)
+{
+    int blocked;
+
+    neighbour_lock(link->src, 1);
+    blocked = link->frame_blocked_in;
+    neighbour_lock(link->src, 0);
+    return blocked;
+}
+
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
+    neighbour_lock(filter, 1);
     filter->ready = FFMAX(filter->ready, priority);
+    neighbour_lock(filter, 0);
 }
 
 /**
@@ -203,8 +233,10 @@ static void filter_unblock(AVFilterContext *filter)
 {
     unsigned i;
 
+    neighbour_lock(filter, 1);
     for (i = 0; i < filter->nb_outputs; i++)
         filter->outputs[i]->frame_blocked_in = 0;
+    neighbour_lock(filter, 0);
 }
 
 
@@ -216,7 +248,9 @@ void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
     link->status_in = status;
     link->status_in_pts = pts;
     link->frame_wanted_out = 0;
+    neighbour_lock(link->src, 1);
     link->frame_blocked_in = 0;
+    neighbour_lock(link->src, 0);
     filter_unblock(link->dst);
     ff_filter_set_ready(link->dst, 200);
 }
@@ -453,7 +487,9 @@ static int ff_request_frame_to_filter(AVFilterLink *link)
 
     FF_TPRINTF_START(NULL, request_frame_to_filter); ff_tlog_link(NULL, link, 1);
     /* Assume the filter is blocked, let the method clear it if not */
+    neighbour_lock(link->src, 1);
     link->frame_blocked_in = 1;
+    neighbour_lock(link->src, 0);
     if (link->srcpad->request_frame)
         ret = link->srcpad->request_frame(link);
     else if (link->src->inputs[0])
@@ -691,8 +727,8 @@ static const AVClass avfilter_class = {
     .option           = avfilter_options,
 };
 
-static int default_execute(AVFilterContext *ctx, avfilter_action_func *func, void *arg,
-                           int *ret, int nb_jobs)
+int ff_filter_execute_default(AVFilterContext *ctx, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs)
 {
     int i;
 
@@ -739,7 +775,7 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name)
     ret->internal = av_mallocz(sizeof(*ret->internal));
     if (!ret->internal)
         goto err;
-    ret->internal->execute = default_execute;
+    ret->internal->execute = ff_filter_execute_default;
 
     ret->nb_inputs = avfilter_pad_count(filter->inputs);
     if (ret->nb_inputs ) {
@@ -1320,7 +1356,7 @@ static int ff_filter_activate_default(AVFilterContext *filter)
     }
     for (i = 0; i < filter->nb_outputs; i++) {
         if (filter->outputs[i]->frame_wanted_out &&
-            !filter->outputs[i]->frame_blocked_in) {
+            !link_blocked_in(filter->outputs[i])) {
             return ff_request_frame_to_filter(filter->outputs[i]);
         }
     }
@@ -1646,7 +1682,9 @@ void ff_inlink_set_status(AVFilterLink *link, int status)
     if (link->status_out)
         return;
     link->frame_wanted_out = 0;
+    neighbour_lock(link->dst, 1);
     link->frame_blocked_in = 0;
+    neighbour_lock(link->dst, 0);
     ff_avfilter_link_set_out_status(link, status, AV_NOPTS_VALUE);
     while (ff_framequeue_queued_frames(&link->fifo)) {
            AVFrame *frame = ff_framequeue_take(&link->fifo);
@@ -1686,3 +1724,15 @@ int ff_filter_init_hw_frames(AVFilterContext *avctx, AVFilterLink *link,
 
     return 0;
 }
+
+int ff_set_meta(AVDictionary **metadata, const char *key, const char *fmt, ...)
+{
+    char buf[128];
+    va_list vl;
+
+    va_start(vl, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, vl);
+    va_end(vl);
+
+    return av_dict_set(metadata, key, buf, 0);
+}
@@ -332,6 +332,13 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate independent filters of a graph concurrently. This type is only
+ * meaningful for AVFilterGraph.thread_type. The output of the graph does not
+ * depend on the number of threads.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -642,6 +649,13 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Frame rate above which the filters downstream of the link drop the
+     * frames, with a numerator of 0 if they need all of them. This is only
+     * a hint, set while the graph is configured.
+     */
+    AVRational wanted_frame_rate;
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -879,6 +893,13 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * If set, count the activations of each filter and the time spent in
+     * them, and log them when the graph is freed. May be set by the caller
+     * before the graph is configured.
+     */
+    int activation_stats;
+
     /**
      * Private fields
      *
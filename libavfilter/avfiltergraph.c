@@ -32,6 +32,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -50,12 +51,15 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "activation_stats", "log the activation statistics of the filters", OFFSET(activation_stats),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
     { NULL },
 };
 
@@ -74,7 +78,7 @@ void ff_graph_thread_free(AVFilterGraph *graph)
 
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
-    graph->thread_type = 0;
+    graph->thread_type &= AVFILTER_THREAD_GRAPH;
     graph->nb_threads  = 1;
     return 0;
 }
@@ -95,6 +99,7 @@ AVFilterGraph *avfilter_graph_alloc(void)
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
+    ff_mutex_init(&ret->internal->sched_lock, NULL);
 
     return ret;
 }
@@ -117,15 +122,47 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
     }
 }
 
+static void log_activation_stats(AVFilterGraph *graph)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    uint64_t nb_activations = 0;
+    int i;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (!f->internal->nb_activations)
+            continue;
+        av_log(f, AV_LOG_INFO, "%"PRIu64" activations, %.3fs, %.1fus/activation\n",
+               f->internal->nb_activations, f->internal->activate_time / 1000000.0,
+               (double)f->internal->activate_time / f->internal->nb_activations);
+        nb_activations += f->internal->nb_activations;
+    }
+    if (nb_activations)
+        av_log(graph, AV_LOG_INFO, "%"PRIu64" activations, %"PRIu64" in %"PRIu64
+               " concurrent batches\n", nb_activations, gi->nb_batched, gi->nb_batches);
+}
+
 void avfilter_graph_free(AVFilterGraph **graph)
 {
+    int i;
+
     if (!*graph)
         return;
 
+    if ((*graph)->internal->sched_stats)
+        log_activation_stats(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    ff_mutex_destroy(&(*graph)->internal->sched_lock);
+    av_freep(&(*graph)->internal->sched_batch);
+
+    for (i = 0; i < (*graph)->internal->nb_video_pools; i++)
+        ff_frame_pool_uninit(&(*graph)->internal->video_pools[i]);
+    av_freep(&(*graph)->internal->video_pools);
 
     av_freep(&(*graph)->sink_links);
 
@@ -1263,6 +1300,50 @@ static int graph_insert_fifos(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
+static int graph_config_scheduler(AVFilterGraph *graph)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+
+    gi->sched_stats = graph->activation_stats;
+    if (!(graph->thread_type & AVFILTER_THREAD_GRAPH))
+        return 0;
+
+    av_freep(&gi->sched_batch);
+    gi->sched_batch_size = 0;
+    gi->sched_batch = av_malloc_array(graph->nb_filters, sizeof(*gi->sched_batch));
+    if (!gi->sched_batch)
+        return AVERROR(ENOMEM);
+    gi->sched_batch_size = graph->nb_filters;
+    return 0;
+}
+
+/**
+ * Propagate the frame rates wanted by the filters upstream, through the
+ * filters which keep the timestamps of their input frames.
+ */
+static void graph_propagate_wanted_frame_rate(AVFilterGraph *graph)
+{
+    int i, changed;
+
+    do {
+        changed = 0;
+        for (i = 0; i < graph->nb_filters; i++) {
+            AVFilterContext *f = graph->filters[i];
+            AVFilterLink *in, *out;
+
+            if (!(f->filter->flags_internal & FF_FILTER_FLAG_KEEPS_TIMESTAMPS) ||
+                f->nb_inputs != 1 || f->nb_outputs != 1)
+                continue;
+            in  = f->inputs[0];
+            out = f->outputs[0];
+            if (out->wanted_frame_rate.num && !in->wanted_frame_rate.num) {
+                in->wanted_frame_rate = out->wanted_frame_rate;
+                changed = 1;
+            }
+        }
+    } while (changed);
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1279,6 +1360,9 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    graph_propagate_wanted_frame_rate(graphctx);
+    if ((ret = graph_config_scheduler(graphctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -1438,10 +1522,105 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+static int activate_filter(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    int64_t t0;
+    int ret;
+
+    if (!graph->internal->sched_stats)
+        return ff_filter_activate(filter);
+
+    t0  = av_gettime_relative();
+    ret = ff_filter_activate(filter);
+    filter->internal->activate_time += av_gettime_relative() - t0;
+    filter->internal->nb_activations++;
+    return ret;
+}
+
+static int activate_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AVFilterContext *filter = ((AVFilterContext **)arg)[jobnr];
+
+    filter->internal->sched_ret = activate_filter(filter->graph, filter);
+    return 0;
+}
+
+static int filter_is_marked_neighbour(AVFilterContext *filter)
+{
+    unsigned i;
+
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i]->src->internal->sched_mark)
+            return 1;
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i]->dst->internal->sched_mark)
+            return 1;
+    return 0;
+}
+
+/**
+ * Select the filters with the highest ready priority which can be activated
+ * concurrently: no two of them are linked together and at most one of them
+ * is a sink, since sinks update the graph-wide heap of sink links.
+ *
+ * The selection only depends on the state of the graph, never on the number
+ * of threads or on their timing, so that the output is deterministic.
+ */
+static int select_batch(AVFilterGraph *graph, unsigned ready)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    int i, nb = 0, sink = 0;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (f->ready != ready || (!f->nb_outputs && sink) ||
+            filter_is_marked_neighbour(f))
+            continue;
+        sink |= !f->nb_outputs;
+        f->internal->sched_mark = 1;
+        gi->sched_batch[nb++] = f;
+    }
+    for (i = 0; i < nb; i++)
+        gi->sched_batch[i]->internal->sched_mark = 0;
+    return nb;
+}
+
+static int run_batch(AVFilterGraph *graph, int nb)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    AVFilterContext **batch = gi->sched_batch;
+    int i, ret = 0;
+
+    if (gi->thread_execute) {
+        /* the workers are busy with the batch, slice threading of the
+         * filters themselves would deadlock */
+        for (i = 0; i < nb; i++)
+            batch[i]->internal->execute = ff_filter_execute_default;
+        gi->sched_busy = 1;
+        gi->thread_execute(batch[0], activate_job, batch, NULL, nb);
+        gi->sched_busy = 0;
+        for (i = 0; i < nb; i++)
+            if (batch[i]->thread_type & AVFILTER_THREAD_SLICE)
+                batch[i]->internal->execute = gi->thread_execute;
+    } else {
+        for (i = 0; i < nb; i++)
+            activate_job(batch[i], batch, i, nb);
+    }
+    gi->nb_batches++;
+    gi->nb_batched += nb;
+
+    /* report the first error in graph order, whatever the thread timing */
+    for (i = 0; i < nb && !ret; i++)
+        ret = batch[i]->internal->sched_ret;
+    return ret;
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
     unsigned i;
+    int nb;
 
     av_assert0(graph->nb_filters);
     filter = graph->filters[0];
@@ -1450,5 +1629,11 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
-    return ff_filter_activate(filter);
+
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH &&
+        graph->internal->sched_batch_size >= graph->nb_filters &&
+        (nb = select_batch(graph, filter->ready)) > 1)
+        return run_batch(graph, nb);
+
+    return activate_filter(graph, filter);
 }
@@ -33,6 +33,10 @@
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
+
+#define FF_INTERNAL_FIELDS 1
+#include "framequeue.h"
+
 #include "audio.h"
 #include "avfilter.h"
 #include "buffersrc.h"
@@ -295,6 +299,13 @@ unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
     return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
 }
 
+AVRational av_buffersrc_get_wanted_frame_rate(AVFilterContext *buffer_src)
+{
+    AVRational rate = buffer_src->outputs[0]->wanted_frame_rate;
+
+    return rate.num > 0 && rate.den > 0 ? rate : (AVRational){ 0, 1 };
+}
+
 #define OFFSET(x) offsetof(BufferSourceContext, x)
 #define A AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_AUDIO_PARAM
 #define V AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
@@ -63,6 +63,18 @@ enum {
  */
 unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src);
 
+/**
+ * Get the frame rate above which the frames sent to the buffer source are
+ * dropped by the filters of the graph, e.g. the fps filter.
+ *
+ * This is only a hint, which allows the caller to skip the decoding of
+ * frames which are not needed. It is only available once the graph is
+ * configured.
+ *
+ * @return the frame rate, or 0/1 if all the frames are needed
+ */
+AVRational av_buffersrc_get_wanted_frame_rate(AVFilterContext *buffer_src);
+
 /**
  * This structure contains the parameters describing the frames that will be
  * passed to this filter.
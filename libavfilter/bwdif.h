@@ -51,6 +51,7 @@ typedef struct BWDIFContext {
     AVFrame *next;
     AVFrame *prev;
     AVFrame *out;
+    AVFrame *second;    ///< second field of the current frame, already filtered
 
     void (*filter_intra)(void *dst1, void *cur1, int w, int prefs, int mrefs,
                          int prefs3, int mrefs3, int parity, int clip_max);
@@ -588,6 +588,35 @@ static void blend_line_hv16(uint8_t *dst, int dst_delta,
                       right, hband, hsub + vsub, xm);
 }
 
+/**
+ * Blend a line of pixels with an 8-bit mask, for planes subsampled at most
+ * by 2 and a band of at most 2 mask rows. Same result as blend_pixel() on
+ * each pixel, but the pixels under transparent parts of the mask are skipped.
+ */
+static void blend_line_gray8(uint8_t *dst, int dst_delta,
+                             unsigned src, unsigned alpha,
+                             const uint8_t *mask, int mask_linesize, int w,
+                             unsigned hsub, unsigned shift, int hband)
+{
+    const uint8_t *m2 = mask + (hband == 2 ? mask_linesize : 0);
+    int x;
+
+    for (x = 0; x < w; x++) {
+        unsigned t;
+
+        if (!hsub)
+            t = mask[x] + (hband == 2 ? m2[x] : 0);
+        else
+            t = mask[2 * x] + mask[2 * x + 1] +
+                (hband == 2 ? m2[2 * x] + m2[2 * x + 1] : 0);
+        if (t) {
+            unsigned a = (t >> shift) * alpha;
+            *dst = ((0x1010101 - a) * *dst + a * src) >> 24;
+        }
+        dst += dst_delta;
+    }
+}
+
 static void blend_line_hv(uint8_t *dst, int dst_delta,
                           unsigned src, unsigned alpha,
                           const uint8_t *mask, int mask_linesize, int l2depth, int w,
@@ -602,6 +631,13 @@ static void blend_line_hv(uint8_t *dst, int dst_delta,
         dst += dst_delta;
         xm += left;
     }
+    if (l2depth == 3 && hsub <= 1 && hband <= 2) {
+        blend_line_gray8(dst, dst_delta, src, alpha, mask + xm, mask_linesize,
+                         w, hsub, hsub + vsub, hband);
+        dst += w * dst_delta;
+        xm  += w << hsub;
+        w    = 0;
+    }
     for (x = 0; x < w; x++) {
         blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
                     1 << hsub, hband, hsub + vsub, xm);
@@ -28,11 +28,11 @@
 #include "libavutil/fifo.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
-#include "libavutil/pixelutils.h"
 #include "avfilter.h"
 #include "audio.h"
 #include "formats.h"
 #include "internal.h"
+#include "scene_score.h"
 #include "video.h"
 
 static const char *const var_names[] = {
@@ -81,6 +81,7 @@ static const char *const var_names[] = {
     "pos",               ///< original position in the file of the frame
 
     "scene",
+    "scene_hist",        ///< difference of the brightness histograms with the previous frame
 
     "concatdec_select",  ///< frame is within the interval set by the concat demuxer
 
@@ -133,6 +134,7 @@ enum var_name {
     VAR_POS,
 
     VAR_SCENE,
+    VAR_SCENE_HIST,
 
     VAR_CONCATDEC_SELECT,
 
@@ -145,9 +147,7 @@ typedef struct SelectContext {
     AVExpr *expr;
     double var_values[VAR_VARS_NB];
     int do_scene_detect;            ///< 1 if the expression requires scene detection variables, 0 otherwise
-    av_pixelutils_sad_fn sad;       ///< Sum of the absolute difference function (scene detect only)
-    double prev_mafd;               ///< previous MAFD                           (scene detect only)
-    AVFrame *prev_picref;           ///< previous frame                          (scene detect only)
+    FFSceneScore scene;             ///< scene change scoring                    (scene detect only)
     double select;
     int select_out;                 ///< mark the selected output pad index
     int nb_outputs;
@@ -177,6 +177,7 @@ static av_cold int init(AVFilterContext *ctx)
         return ret;
     }
     select->do_scene_detect = !!strstr(select->expr_str, "scene");
+    select->scene.hist      = !!strstr(select->expr_str, "scene_hist");
 
     for (i = 0; i < select->nb_outputs; i++) {
         AVFilterPad pad = { 0 };
@@ -235,56 +236,18 @@ static int config_input(AVFilterLink *inlink)
     select->var_values[VAR_PICT_TYPE]         = NAN;
     select->var_values[VAR_INTERLACE_TYPE]    = NAN;
     select->var_values[VAR_SCENE]             = NAN;
+    select->var_values[VAR_SCENE_HIST]        = NAN;
     select->var_values[VAR_CONSUMED_SAMPLES_N] = NAN;
     select->var_values[VAR_SAMPLES_N]          = NAN;
 
     select->var_values[VAR_SAMPLE_RATE] =
         inlink->type == AVMEDIA_TYPE_AUDIO ? inlink->sample_rate : NAN;
 
-    if (select->do_scene_detect) {
-        select->sad = av_pixelutils_get_sad_fn(3, 3, 2, select); // 8x8 both sources aligned
-        if (!select->sad)
-            return AVERROR(EINVAL);
-    }
+    if (select->do_scene_detect)
+        return ff_scene_score_init(&select->scene, inlink->dst, inlink->format);
     return 0;
 }
 
-static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
-{
-    double ret = 0;
-    SelectContext *select = ctx->priv;
-    AVFrame *prev_picref = select->prev_picref;
-
-    if (prev_picref &&
-        frame->height == prev_picref->height &&
-        frame->width  == prev_picref->width) {
-        int x, y, nb_sad = 0;
-        int64_t sad = 0;
-        double mafd, diff;
-        uint8_t *p1 =      frame->data[0];
-        uint8_t *p2 = prev_picref->data[0];
-        const int p1_linesize =       frame->linesize[0];
-        const int p2_linesize = prev_picref->linesize[0];
-
-        for (y = 0; y < frame->height - 7; y += 8) {
-            for (x = 0; x < frame->width*3 - 7; x += 8) {
-                sad += select->sad(p1 + x, p1_linesize, p2 + x, p2_linesize);
-                nb_sad += 8 * 8;
-            }
-            p1 += 8 * p1_linesize;
-            p2 += 8 * p2_linesize;
-        }
-        emms_c();
-        mafd = nb_sad ? (double)sad / nb_sad : 0;
-        diff = fabs(mafd - select->prev_mafd);
-        ret  = av_clipf(FFMIN(mafd, diff) / 100., 0, 1);
-        select->prev_mafd = mafd;
-        av_frame_free(&prev_picref);
-    }
-    select->prev_picref = av_frame_clone(frame);
-    return ret;
-}
-
 static double get_concatdec_select(AVFrame *frame, int64_t pts)
 {
     AVDictionary *metadata = frame->metadata;
@@ -310,11 +273,12 @@ static double get_concatdec_select(AVFrame *frame, int64_t pts)
 #define D2TS(d)  (isnan(d) ? AV_NOPTS_VALUE : (int64_t)(d))
 #define TS2D(ts) ((ts) == AV_NOPTS_VALUE ? NAN : (double)(ts))
 
-static void select_frame(AVFilterContext *ctx, AVFrame *frame)
+static int select_frame(AVFilterContext *ctx, AVFrame *frame)
 {
     SelectContext *select = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
     double res;
+    int ret;
 
     if (isnan(select->var_values[VAR_START_PTS]))
         select->var_values[VAR_START_PTS] = TS2D(frame->pts);
@@ -339,11 +303,11 @@ static void select_frame(AVFilterContext *ctx, AVFrame *frame)
         frame->top_field_first ? INTERLACE_TYPE_T : INTERLACE_TYPE_B;
         select->var_values[VAR_PICT_TYPE] = frame->pict_type;
         if (select->do_scene_detect) {
-            char buf[32];
-            select->var_values[VAR_SCENE] = get_scene_score(ctx, frame);
-            // TODO: document metadata
-            snprintf(buf, sizeof(buf), "%f", select->var_values[VAR_SCENE]);
-            av_dict_set(&frame->metadata, "lavfi.scene_score", buf, 0);
+            if ((ret = ff_scene_score_frame(&select->scene, frame)) < 0 ||
+                (ret = ff_scene_score_export(&select->scene, &frame->metadata)) < 0)
+                return ret;
+            select->var_values[VAR_SCENE]      = select->scene.score;
+            select->var_values[VAR_SCENE_HIST] = select->scene.hist_diff;
         }
         break;
     }
@@ -392,14 +356,19 @@ static void select_frame(AVFilterContext *ctx, AVFrame *frame)
 
     select->var_values[VAR_PREV_PTS] = select->var_values[VAR_PTS];
     select->var_values[VAR_PREV_T]   = select->var_values[VAR_T];
+    return 0;
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     SelectContext *select = ctx->priv;
+    int ret;
 
-    select_frame(ctx, frame);
+    if ((ret = select_frame(ctx, frame)) < 0) {
+        av_frame_free(&frame);
+        return ret;
+    }
     if (select->select)
         return ff_filter_frame(ctx->outputs[select->select_out], frame);
 
@@ -425,9 +394,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
 
-    if (select->do_scene_detect) {
-        av_frame_free(&select->prev_picref);
-    }
+    if (select->do_scene_detect)
+        ff_scene_score_uninit(&select->scene);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -530,6 +498,6 @@ AVFilter ff_vf_select = {
     .priv_size     = sizeof(SelectContext),
     .priv_class    = &select_class,
     .inputs        = avfilter_vf_select_inputs,
-    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif /* CONFIG_SELECT_FILTER */
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "framepool.h"
@@ -149,10 +150,36 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    /**
+     * Video frame pools shared by all the links of the graph, one per
+     * frame geometry, see ff_default_get_video_buffer(). They are ordered
+     * from the least to the most recently used.
+     */
+    FFFramePool **video_pools;
+    int nb_video_pools;
+
+    /**
+     * Set while several filters are activated concurrently, see
+     * ff_filter_graph_run_once(). The state shared between the running
+     * filters is then protected by sched_lock.
+     */
+    int sched_busy;
+    AVMutex sched_lock;
+    AVFilterContext **sched_batch;
+    unsigned sched_batch_size;
+
+    int sched_stats;            ///< collect per-filter activation statistics
+    uint64_t nb_batches;        ///< number of concurrent batches run
+    uint64_t nb_batched;        ///< number of activations run in batches
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    int sched_mark;             ///< filter is part of the batch being built
+    int sched_ret;              ///< return value of the last batched activation
+    uint64_t nb_activations;
+    int64_t activate_time;      ///< total time spent activating, in microseconds
 };
 
 /**
@@ -373,6 +400,12 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name);
 
 int ff_filter_activate(AVFilterContext *filter);
 
+/**
+ * Execute func serially for all jobs, in the calling thread.
+ */
+int ff_filter_execute_default(AVFilterContext *ctx, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs);
+
 /**
  * Remove a filter from a graph;
  */
@@ -384,6 +417,16 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter has a single input and a single output, each output frame is
+ * the input frame with the same timestamp, and its processing does not
+ * depend on the number or timing of the input frames. The frame rate wanted
+ * on the output is propagated to the input, so frames may be dropped before
+ * the filter: filters counting frames, like trim, or evaluating per-frame
+ * expressions, like crop, must not set it.
+ */
+#define FF_FILTER_FLAG_KEEPS_TIMESTAMPS (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -427,4 +470,13 @@ int ff_filter_get_nb_threads(AVFilterContext *ctx);
 int ff_filter_init_hw_frames(AVFilterContext *avctx, AVFilterLink *link,
                              int default_pool_size);
 
+/**
+ * Set a metadata entry to a printf-style formatted value, as the filters
+ * exporting measurements in the frame metadata do.
+ *
+ * @return >= 0 on success, a negative AVERROR code on failure
+ */
+int ff_set_meta(AVDictionary **metadata, const char *key,
+                const char *fmt, ...) av_printf_format(3, 4);
+
 #endif /* AVFILTER_INTERNAL_H */
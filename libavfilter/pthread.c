@@ -86,7 +86,7 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     int ret;
 
     if (graph->nb_threads == 1) {
-        graph->thread_type = 0;
+        graph->thread_type &= AVFILTER_THREAD_GRAPH;
         return 0;
     }
 
@@ -97,7 +97,7 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
     if (ret <= 1) {
         av_freep(&graph->internal->thread);
-        graph->thread_type = 0;
+        graph->thread_type &= AVFILTER_THREAD_GRAPH;
         graph->nb_threads  = 1;
         return (ret < 0) ? ret : 0;
     }
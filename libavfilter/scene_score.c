@@ -0,0 +1,212 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Scene change scoring
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "internal.h"
+#include "scene_score.h"
+
+int ff_scene_score_supported(enum AVPixelFormat format)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    int i;
+
+    /* packed 24 bits RGB */
+    if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_RGB) ||
+        desc->flags & (AV_PIX_FMT_FLAG_PLANAR | AV_PIX_FMT_FLAG_PAL |
+                       AV_PIX_FMT_FLAG_HWACCEL) ||
+        desc->nb_components != 3)
+        return 0;
+    for (i = 0; i < 3; i++)
+        if (desc->comp[i].depth != 8 || desc->comp[i].step != 3)
+            return 0;
+    return 1;
+}
+
+int ff_scene_score_init(FFSceneScore *s, AVFilterContext *parent,
+                        enum AVPixelFormat format)
+{
+    int nb_jobs = ff_filter_get_nb_threads(parent);
+
+    if (!ff_scene_score_supported(format)) {
+        av_log(parent, AV_LOG_ERROR, "Unsupported pixel format %s for scene scoring\n",
+               av_get_pix_fmt_name(format));
+        return AVERROR(EINVAL);
+    }
+
+    ff_scene_score_uninit(s);
+    s->parent     = parent;
+    s->sad        = av_pixelutils_get_sad_fn(3, 3, 2, parent); // 8x8 both sources aligned
+    if (!s->sad)
+        return AVERROR(EINVAL);
+    s->prev_mafd  = 0;
+    s->has_prev_hist = 0;
+
+    s->job_sad = av_calloc(nb_jobs, sizeof(*s->job_sad));
+    if (!s->job_sad)
+        return AVERROR(ENOMEM);
+    if (s->hist) {
+        s->job_hist = av_calloc(nb_jobs, sizeof(*s->job_hist));
+        if (!s->job_hist)
+            return AVERROR(ENOMEM);
+    }
+    s->nb_jobs = nb_jobs;
+    return 0;
+}
+
+typedef struct ThreadData {
+    FFSceneScore *s;
+    const AVFrame *cur, *prev;
+} ThreadData;
+
+static void hist_slice(const AVFrame *frame, uint32_t *hist, int start, int end)
+{
+    const int w = frame->width;
+    int x, y;
+
+    memset(hist, 0, sizeof(*hist) * FF_SCENE_HIST_BINS);
+    for (y = FFALIGN(start, 4); y < end; y += 4) {
+        const uint8_t *p = frame->data[0] + y * frame->linesize[0];
+
+        for (x = 0; x < w; x += 4, p += 4 * 3)
+            hist[(p[0] + 2 * p[1] + p[2]) >> 4]++;
+    }
+}
+
+static int score_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const ThreadData *td = arg;
+    FFSceneScore *s = td->s;
+    const int rows  = s->height >> 3;
+    const int start = (rows *  jobnr     ) / nb_jobs * 8;
+    const int end   = (rows * (jobnr + 1)) / nb_jobs * 8;
+    const int w     = s->bytewidth;
+    const int p1_linesize = td->cur ->linesize[0];
+    const int p2_linesize = td->prev->linesize[0];
+    const uint8_t *p1 = td->cur ->data[0] + start * p1_linesize;
+    const uint8_t *p2 = td->prev->data[0] + start * p2_linesize;
+    uint64_t sad = 0;
+    int x, y;
+
+    for (y = start; y < end; y += 8) {
+        for (x = 0; x < w - 7; x += 8)
+            sad += s->sad(p1 + x, p1_linesize, p2 + x, p2_linesize);
+        p1 += 8 * p1_linesize;
+        p2 += 8 * p2_linesize;
+    }
+    emms_c();
+    s->job_sad[jobnr] = sad;
+
+    if (s->hist)
+        hist_slice(td->cur, s->job_hist[jobnr],
+                   (s->height *  jobnr     ) / nb_jobs,
+                   (s->height * (jobnr + 1)) / nb_jobs);
+    return 0;
+}
+
+int ff_scene_score_frame(FFSceneScore *s, const AVFrame *frame)
+{
+    AVFrame *prev = s->prev;
+    int i, j, nb_jobs;
+
+    s->score = s->mafd = s->hist_diff = 0;
+    s->bytewidth = frame->width * 3;
+    s->height    = frame->height;
+    nb_jobs = av_clip(s->height >> 3, 1, s->nb_jobs);
+
+    if (prev && frame->width  == prev->width &&
+                frame->height == prev->height) {
+        ThreadData td = { .s = s, .cur = frame, .prev = prev };
+        uint64_t sad = 0, nb_sad;
+        double diff;
+
+        s->parent->internal->execute(s->parent, score_slice, &td, NULL, nb_jobs);
+
+        for (i = 0; i < nb_jobs; i++)
+            sad += s->job_sad[i];
+        nb_sad = (uint64_t)(s->bytewidth & ~7) * (s->height & ~7);
+
+        s->mafd  = nb_sad ? (double)sad / nb_sad : 0;
+        diff     = fabs(s->mafd - s->prev_mafd);
+        s->score = av_clipf(FFMIN(s->mafd, diff) / 100., 0, 1);
+        s->prev_mafd = s->mafd;
+    } else if (s->hist) {
+        for (i = 0; i < nb_jobs; i++)
+            hist_slice(frame, s->job_hist[i],
+                       (s->height *  i     ) / nb_jobs,
+                       (s->height * (i + 1)) / nb_jobs);
+    }
+
+    if (s->hist) {
+        uint32_t hist[FF_SCENE_HIST_BINS] = { 0 };
+        uint64_t diff = 0, total = 0;
+
+        for (i = 0; i < nb_jobs; i++)
+            for (j = 0; j < FF_SCENE_HIST_BINS; j++)
+                hist[j] += s->job_hist[i][j];
+        if (s->has_prev_hist) {
+            for (j = 0; j < FF_SCENE_HIST_BINS; j++) {
+                diff  += FFABS((int64_t)hist[j] - s->prev_hist[j]);
+                total += hist[j] + s->prev_hist[j];
+            }
+            s->hist_diff = total ? (double)diff / total : 0;
+        }
+        memcpy(s->prev_hist, hist, sizeof(hist));
+        s->has_prev_hist = 1;
+    }
+
+    av_frame_free(&s->prev);
+    s->prev = av_frame_clone(frame);
+    return s->prev ? 0 : AVERROR(ENOMEM);
+}
+
+int ff_scene_score_export(FFSceneScore *s, AVDictionary **metadata)
+{
+    char buf[32];
+    int ret;
+
+    snprintf(buf, sizeof(buf), "%f", s->score);
+    if ((ret = av_dict_set(metadata, "lavfi.scene_score", buf, 0)) < 0)
+        return ret;
+    if (s->hist) {
+        snprintf(buf, sizeof(buf), "%f", s->mafd);
+        if ((ret = av_dict_set(metadata, "lavfi.scene_mafd", buf, 0)) < 0)
+            return ret;
+        snprintf(buf, sizeof(buf), "%f", s->hist_diff);
+        if ((ret = av_dict_set(metadata, "lavfi.scene_hist", buf, 0)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+void ff_scene_score_uninit(FFSceneScore *s)
+{
+    av_frame_free(&s->prev);
+    av_freep(&s->job_sad);
+    av_freep(&s->job_hist);
+    s->nb_jobs = 0;
+}
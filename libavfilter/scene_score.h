@@ -0,0 +1,106 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_SCENE_SCORE_H
+#define AVFILTER_SCENE_SCORE_H
+
+/**
+ * @file
+ * Scene change scoring, shared by the filters which need it.
+ */
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#include "libavutil/pixelutils.h"
+#include "avfilter.h"
+
+#define FF_SCENE_HIST_BINS 64
+
+/**
+ * The score of a frame is derived from the mean absolute frame difference
+ * (MAFD) with the previous frame, computed on 8x8 blocks of all the bytes
+ * of a packed 24 bits RGB picture, and from its change since the previous
+ * frame. It is the score historically computed by the select filter.
+ *
+ * If requested, the difference of the brightness histograms of the two
+ * frames is also computed, on a picture decimated by 4 in both directions.
+ *
+ * The work is split in slices run with the slice threads of the parent
+ * filter, which must have the AVFILTER_FLAG_SLICE_THREADS flag.
+ */
+typedef struct FFSceneScore {
+    /**
+     * Compute the histogram difference too, must be set before
+     * ff_scene_score_init().
+     */
+    int hist;
+
+    AVFilterContext *parent;
+    av_pixelutils_sad_fn sad;   ///< 8x8 SAD, SIMD optimized if possible
+    int bytewidth;          ///< width of the current frame, in bytes
+    int height;             ///< height of the current frame
+
+    AVFrame *prev;          ///< previous frame
+    double prev_mafd;
+    uint32_t prev_hist[FF_SCENE_HIST_BINS];
+    int has_prev_hist;
+
+    int nb_jobs;
+    uint64_t *job_sad;
+    uint32_t (*job_hist)[FF_SCENE_HIST_BINS];
+
+    /* results for the last frame */
+    double mafd;            ///< mean absolute frame difference
+    double hist_diff;       ///< histogram difference, in [0, 1]
+    double score;           ///< scene change score, in [0, 1]
+} FFSceneScore;
+
+/**
+ * Tell if frames of the given pixel format can be scored.
+ */
+int ff_scene_score_supported(enum AVPixelFormat format);
+
+/**
+ * Initialize the scoring of frames of the given pixel format.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_scene_score_init(FFSceneScore *s, AVFilterContext *parent,
+                        enum AVPixelFormat format);
+
+/**
+ * Score a frame against the previous one, which is replaced by a new
+ * reference to frame. The first frame, or a frame whose size differs from
+ * the previous one, gets a score of 0. The results are stored in s.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_scene_score_frame(FFSceneScore *s, const AVFrame *frame);
+
+/**
+ * Export the results for the last frame in a metadata dictionary, as
+ * lavfi.scene_score and, if computed, lavfi.scene_mafd and lavfi.scene_hist.
+ */
+int ff_scene_score_export(FFSceneScore *s, AVDictionary **metadata);
+
+void ff_scene_score_uninit(FFSceneScore *s);
+
+#endif /* AVFILTER_SCENE_SCORE_H */
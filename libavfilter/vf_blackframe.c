@@ -60,10 +60,6 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_formats(ctx, fmts_list);
 }
 
-#define SET_META(key, format, value) \
-    snprintf(buf, sizeof(buf), format, value);  \
-    av_dict_set(metadata, key, buf, 0)
-
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -72,7 +68,6 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     int pblack = 0;
     uint8_t *p = frame->data[0];
     AVDictionary **metadata;
-    char buf[32];
 
     for (i = 0; i < frame->height; i++) {
         for (x = 0; x < inlink->w; x++)
@@ -93,7 +88,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
                frame->pts == AV_NOPTS_VALUE ? -1 : frame->pts * av_q2d(inlink->time_base),
                av_get_picture_type_char(frame->pict_type), s->last_keyframe);
 
-        SET_META("lavfi.blackframe.pblack", "%u", pblack);
+        ff_set_meta(metadata, "lavfi.blackframe.pblack", "%u", pblack);
     }
 
     s->frame++;
@@ -70,7 +70,9 @@ typedef struct BoxBlurContext {
     int hsub, vsub;
     int radius[4];
     int power[4];
-    uint8_t *temp[2]; ///< temporary buffer used in blur_power()
+    uint8_t *temp[2]; ///< temporary buffer used in blur_power(), one per slice thread
+    int temp_size;
+    int nb_threads;
 } BoxBlurContext;
 
 #define Y 0
@@ -143,8 +145,10 @@ static int config_input(AVFilterLink *inlink)
     char *expr;
     int ret;
 
-    if (!(s->temp[0] = av_malloc(2*FFMAX(w, h))) ||
-        !(s->temp[1] = av_malloc(2*FFMAX(w, h))))
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp_size  = 2*FFMAX(w, h);
+    if (!(s->temp[0] = av_malloc_array(s->temp_size, s->nb_threads)) ||
+        !(s->temp[1] = av_malloc_array(s->temp_size, s->nb_threads)))
         return AVERROR(ENOMEM);
 
     s->hsub = desc->log2_chroma_w;
@@ -319,19 +323,64 @@ static void vblur(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_li
                    h, radius, power, temp, pixsize);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int w[4], h[4];
+    int pixsize;
+} ThreadData;
+
+static int filter_horizontally(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    BoxBlurContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    uint8_t *temp[2] = { s->temp[0] + jobnr * s->temp_size,
+                         s->temp[1] + jobnr * s->temp_size };
+    int plane;
+
+    for (plane = 0; plane < 4 && in->data[plane] && in->linesize[plane]; plane++) {
+        const int slice_start = (td->h[plane] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (td->h[plane] * (jobnr + 1)) / nb_jobs;
+
+        hblur(out->data[plane] + slice_start * out->linesize[plane], out->linesize[plane],
+              in ->data[plane] + slice_start * in ->linesize[plane], in ->linesize[plane],
+              td->w[plane], slice_end - slice_start, s->radius[plane], s->power[plane],
+              temp, td->pixsize);
+    }
+    return 0;
+}
+
+static int filter_vertically(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    BoxBlurContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    uint8_t *temp[2] = { s->temp[0] + jobnr * s->temp_size,
+                         s->temp[1] + jobnr * s->temp_size };
+    int plane;
+
+    for (plane = 0; plane < 4 && in->data[plane] && in->linesize[plane]; plane++) {
+        const int slice_start = (td->w[plane] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (td->w[plane] * (jobnr + 1)) / nb_jobs;
+        uint8_t *p = out->data[plane] + slice_start * td->pixsize;
+
+        vblur(p, out->linesize[plane], p, out->linesize[plane],
+              slice_end - slice_start, td->h[plane], s->radius[plane], s->power[plane],
+              temp, td->pixsize);
+    }
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
     BoxBlurContext *s = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
     AVFrame *out;
-    int plane;
+    ThreadData td;
     int cw = AV_CEIL_RSHIFT(inlink->w, s->hsub), ch = AV_CEIL_RSHIFT(in->height, s->vsub);
-    int w[4] = { inlink->w, cw, cw, inlink->w };
-    int h[4] = { in->height, ch, ch, in->height };
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     const int depth = desc->comp[0].depth;
-    const int pixsize = (depth+7)/8;
 
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -340,17 +389,19 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
     av_frame_copy_props(out, in);
 
-    for (plane = 0; plane < 4 && in->data[plane] && in->linesize[plane]; plane++)
-        hblur(out->data[plane], out->linesize[plane],
-              in ->data[plane], in ->linesize[plane],
-              w[plane], h[plane], s->radius[plane], s->power[plane],
-              s->temp, pixsize);
+    td.in  = in;
+    td.out = out;
+    td.w[0] = td.w[3] = inlink->w;
+    td.w[1] = td.w[2] = cw;
+    td.h[0] = td.h[3] = in->height;
+    td.h[1] = td.h[2] = ch;
+    td.pixsize = (depth+7)/8;
 
-    for (plane = 0; plane < 4 && in->data[plane] && in->linesize[plane]; plane++)
-        vblur(out->data[plane], out->linesize[plane],
-              out->data[plane], out->linesize[plane],
-              w[plane], h[plane], s->radius[plane], s->power[plane],
-              s->temp, pixsize);
+    /* rows, then columns, are filtered independently */
+    ctx->internal->execute(ctx, filter_horizontally, &td, NULL,
+                           FFMIN(ch, s->nb_threads));
+    ctx->internal->execute(ctx, filter_vertically, &td, NULL,
+                           FFMIN(cw, s->nb_threads));
 
     av_frame_free(&in);
 
@@ -409,5 +460,5 @@ AVFilter ff_vf_boxblur = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_boxblur_inputs,
     .outputs       = avfilter_vf_boxblur_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -50,10 +50,10 @@ static const uint16_t coef_hf[3] = { 5570, 3801, 1016 };
 static const uint16_t coef_sp[2] = { 5077, 981 };
 
 typedef struct ThreadData {
-    AVFrame *frame;
-    int plane;
-    int w, h;
-    int parity;
+    AVFrame *frame[2];
+    int parity[2];
+    int inter_field[2];
+    int nb_fields;
     int tff;
 } ThreadData;
 
@@ -213,84 +213,111 @@ static void filter_edge_16bit(void *dst1, void *prev1, void *cur1, void *next1,
     FILTER2()
 }
 
-static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void filter_plane_slice(BWDIFContext *s, AVFrame *frame, int plane,
+                               int w, int h, int parity, int tff, int inter_field,
+                               int slice_start, int slice_end)
 {
-    BWDIFContext *s = ctx->priv;
-    ThreadData *td  = arg;
-    int linesize = s->cur->linesize[td->plane];
-    int clip_max = (1 << (s->csp->comp[td->plane].depth)) - 1;
-    int df = (s->csp->comp[td->plane].depth + 7) / 8;
+    int linesize = s->cur->linesize[plane];
+    int clip_max = (1 << (s->csp->comp[plane].depth)) - 1;
+    int df = (s->csp->comp[plane].depth + 7) / 8;
     int refs = linesize / df;
-    int slice_start = (td->h *  jobnr   ) / nb_jobs;
-    int slice_end   = (td->h * (jobnr+1)) / nb_jobs;
     int y;
 
     for (y = slice_start; y < slice_end; y++) {
-        if ((y ^ td->parity) & 1) {
-            uint8_t *prev = &s->prev->data[td->plane][y * linesize];
-            uint8_t *cur  = &s->cur ->data[td->plane][y * linesize];
-            uint8_t *next = &s->next->data[td->plane][y * linesize];
-            uint8_t *dst  = &td->frame->data[td->plane][y * td->frame->linesize[td->plane]];
-            if (!s->inter_field) {
-                s->filter_intra(dst, cur, td->w, (y + df) < td->h ? refs : -refs,
+        if ((y ^ parity) & 1) {
+            uint8_t *prev = &s->prev->data[plane][y * linesize];
+            uint8_t *cur  = &s->cur ->data[plane][y * linesize];
+            uint8_t *next = &s->next->data[plane][y * linesize];
+            uint8_t *dst  = &frame->data[plane][y * frame->linesize[plane]];
+            if (!inter_field) {
+                s->filter_intra(dst, cur, w, (y + df) < h ? refs : -refs,
                                 y > (df - 1) ? -refs : refs,
-                                (y + 3*df) < td->h ? 3 * refs : -refs,
+                                (y + 3*df) < h ? 3 * refs : -refs,
                                 y > (3*df - 1) ? -3 * refs : refs,
-                                td->parity ^ td->tff, clip_max);
-            } else if ((y < 4) || ((y + 5) > td->h)) {
-                s->filter_edge(dst, prev, cur, next, td->w,
-                               (y + df) < td->h ? refs : -refs,
+                                parity ^ tff, clip_max);
+            } else if ((y < 4) || ((y + 5) > h)) {
+                s->filter_edge(dst, prev, cur, next, w,
+                               (y + df) < h ? refs : -refs,
                                y > (df - 1) ? -refs : refs,
                                refs << 1, -(refs << 1),
-                               td->parity ^ td->tff, clip_max,
-                               (y < 2) || ((y + 3) > td->h) ? 0 : 1);
+                               parity ^ tff, clip_max,
+                               (y < 2) || ((y + 3) > h) ? 0 : 1);
             } else {
-                s->filter_line(dst, prev, cur, next, td->w,
+                s->filter_line(dst, prev, cur, next, w,
                                refs, -refs, refs << 1, -(refs << 1),
                                3 * refs, -3 * refs, refs << 2, -(refs << 2),
-                               td->parity ^ td->tff, clip_max);
+                               parity ^ tff, clip_max);
             }
         } else {
-            memcpy(&td->frame->data[td->plane][y * td->frame->linesize[td->plane]],
-                   &s->cur->data[td->plane][y * linesize], td->w * df);
+            memcpy(&frame->data[plane][y * frame->linesize[plane]],
+                   &s->cur->data[plane][y * linesize], w * df);
         }
     }
-    return 0;
 }
 
-static void filter(AVFilterContext *ctx, AVFrame *dstpic,
-                   int parity, int tff)
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    BWDIFContext *bwdif = ctx->priv;
-    ThreadData td = { .frame = dstpic, .parity = parity, .tff = tff };
-    int i;
+    BWDIFContext *s = ctx->priv;
+    ThreadData *td  = arg;
+    int i, field;
 
-    for (i = 0; i < bwdif->csp->nb_components; i++) {
-        int w = dstpic->width;
-        int h = dstpic->height;
+    for (i = 0; i < s->csp->nb_components; i++) {
+        int w = td->frame[0]->width;
+        int h = td->frame[0]->height;
 
         if (i == 1 || i == 2) {
-            w = AV_CEIL_RSHIFT(w, bwdif->csp->log2_chroma_w);
-            h = AV_CEIL_RSHIFT(h, bwdif->csp->log2_chroma_h);
+            w = AV_CEIL_RSHIFT(w, s->csp->log2_chroma_w);
+            h = AV_CEIL_RSHIFT(h, s->csp->log2_chroma_h);
         }
 
-        td.w     = w;
-        td.h     = h;
-        td.plane = i;
-
-        ctx->internal->execute(ctx, filter_slice, &td, NULL, FFMIN(h, ff_filter_get_nb_threads(ctx)));
+        for (field = 0; field < td->nb_fields; field++)
+            filter_plane_slice(s, td->frame[field], i, w, h,
+                               td->parity[field], td->tff, td->inter_field[field],
+                               (h *  jobnr   ) / nb_jobs,
+                               (h * (jobnr+1)) / nb_jobs);
     }
+    emms_c();
+    return 0;
+}
+
+/**
+ * Filter the planes of the current frame in a single pass of the slice
+ * threads, for dstpic and, if not NULL, for the frame of the second field.
+ */
+static void filter(AVFilterContext *ctx, AVFrame *dstpic, AVFrame *second,
+                   int parity, int tff)
+{
+    BWDIFContext *bwdif = ctx->priv;
+    ThreadData td = { .frame  = { dstpic, second },
+                      .parity = { parity, parity ^ 1 },
+                      .inter_field = { bwdif->inter_field, 1 },
+                      .nb_fields = second ? 2 : 1,
+                      .tff = tff };
+    int h = AV_CEIL_RSHIFT(dstpic->height, bwdif->csp->log2_chroma_h);
+
+    ctx->internal->execute(ctx, filter_slice, &td, NULL,
+                           FFMIN(h, ff_filter_get_nb_threads(ctx)));
     if (!bwdif->inter_field) {
         bwdif->inter_field = 1;
     }
+}
 
-    emms_c();
+static AVFrame *get_field_buffer(AVFilterContext *ctx)
+{
+    BWDIFContext *bwdif = ctx->priv;
+    AVFilterLink *link  = ctx->outputs[0];
+    AVFrame *out = ff_get_video_buffer(link, link->w, link->h);
+
+    if (!out)
+        return NULL;
+    av_frame_copy_props(out, bwdif->cur);
+    out->interlaced_frame = 0;
+    return out;
 }
 
 static int return_frame(AVFilterContext *ctx, int is_second)
 {
     BWDIFContext *bwdif = ctx->priv;
-    AVFilterLink *link  = ctx->outputs[0];
     int tff, ret;
 
     if (bwdif->parity == -1) {
@@ -300,19 +327,29 @@ static int return_frame(AVFilterContext *ctx, int is_second)
         tff = bwdif->parity ^ 1;
     }
 
-    if (is_second) {
-        bwdif->out = ff_get_video_buffer(link, link->w, link->h);
+    /* the last second field is filtered again without the next frame */
+    if (is_second && bwdif->second && bwdif->inter_field >= 0) {
+        bwdif->out    = bwdif->second;
+        bwdif->second = NULL;
+    } else if (is_second) {
+        av_frame_free(&bwdif->second);
+        bwdif->out = get_field_buffer(ctx);
         if (!bwdif->out)
             return AVERROR(ENOMEM);
-
-        av_frame_copy_props(bwdif->out, bwdif->cur);
-        bwdif->out->interlaced_frame = 0;
         if (bwdif->inter_field < 0)
             bwdif->inter_field = 0;
+        filter(ctx, bwdif->out, NULL, tff, tff);
+    } else {
+        /* in field mode, the second field is filtered with the first one and
+         * output once the next frame is requested */
+        if (bwdif->mode & 1) {
+            bwdif->second = get_field_buffer(ctx);
+            if (!bwdif->second)
+                return AVERROR(ENOMEM);
+        }
+        filter(ctx, bwdif->out, bwdif->second, tff ^ 1, tff);
     }
 
-    filter(ctx, bwdif->out, tff ^ !is_second, tff);
-
     if (is_second) {
         int64_t cur_pts  = bwdif->cur->pts;
         int64_t next_pts = bwdif->next->pts;
@@ -460,6 +497,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&bwdif->prev);
     av_frame_free(&bwdif->cur );
     av_frame_free(&bwdif->next);
+    av_frame_free(&bwdif->second);
 }
 
 static int query_formats(AVFilterContext *ctx)
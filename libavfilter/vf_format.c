@@ -180,6 +180,8 @@ AVFilter ff_vf_format = {
 
     .inputs        = avfilter_vf_format_inputs,
     .outputs       = avfilter_vf_format_outputs,
+
+    .flags_internal = FF_FILTER_FLAG_KEEPS_TIMESTAMPS,
 };
 #endif /* CONFIG_FORMAT_FILTER */
 
@@ -219,5 +221,7 @@ AVFilter ff_vf_noformat = {
 
     .inputs        = avfilter_vf_noformat_inputs,
     .outputs       = avfilter_vf_noformat_outputs,
+
+    .flags_internal = FF_FILTER_FLAG_KEEPS_TIMESTAMPS,
 };
 #endif /* CONFIG_NOFORMAT_FILTER */
@@ -128,6 +128,10 @@ static int config_props(AVFilterLink* link)
 
     link->time_base = av_inv_q(s->framerate);
     link->frame_rate= s->framerate;
+    /* the frames kept only depend on the frame rate with the default
+     * rounding and no start time */
+    if (s->rounding == AV_ROUND_NEAR_INF && s->start_time == DBL_MAX)
+        link->src->inputs[0]->wanted_frame_rate = s->framerate;
     link->w         = link->src->inputs[0]->w;
     link->h         = link->src->inputs[0]->h;
 
@@ -0,0 +1,337 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Video health detector: black, frozen and blocky pictures, measured on
+ * a subsampled luma plane.
+ */
+
+#include <float.h>
+
+#include "libavutil/common.h"
+#include "libavutil/opt.h"
+#include "libavutil/timestamp.h"
+#include "avfilter.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+enum HealthEvent {
+    EVENT_BLACK,
+    EVENT_FREEZE,
+    EVENT_BLOCKY,
+    EVENT_NB
+};
+
+static const char *const event_names[EVENT_NB] = { "black", "freeze", "blocky" };
+
+typedef struct HealthSums {
+    int64_t nb_black;       ///< number of black samples
+    int64_t sad;            ///< sum of absolute differences with the previous samples
+    int64_t edge, inner;    ///< sums of horizontal gradients on and inside 8x8 block edges
+} HealthSums;
+
+typedef struct HealthEventState {
+    int active;             ///< the condition holds for the current frame
+    int reported;           ///< the start of the event has been reported
+    int64_t start;          ///< pts of the first frame of the event
+    int64_t last;           ///< pts of the last frame of the event
+} HealthEventState;
+
+typedef struct HealthDetectContext {
+    const AVClass *class;
+    int step;
+    double duration_time;
+    double pixel_black_th;
+    double picture_black_ratio_th;
+    double noise;
+    double block_th;
+
+    int64_t duration;       ///< minimum event duration, in time base units
+    int pixel_black_th_i;
+    int sw, sh;             ///< size of the subsampled plane
+    uint8_t *prev;          ///< subsampled luma of the previous frame
+    int has_prev;
+    HealthEventState events[EVENT_NB];
+    int64_t last_pts;
+
+    int nb_jobs;
+    HealthSums *job_sums;
+} HealthDetectContext;
+
+#define OFFSET(x) offsetof(HealthDetectContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption healthdetect_options[] = {
+    { "step",     "set the subsampling step",                        OFFSET(step),                   AV_OPT_TYPE_INT,    { .i64 = 4 },    1, 64,      FLAGS },
+    { "duration", "set the minimum duration of an event in seconds", OFFSET(duration_time),          AV_OPT_TYPE_DOUBLE, { .dbl = 2 },    0, DBL_MAX, FLAGS },
+    { "d",        "set the minimum duration of an event in seconds", OFFSET(duration_time),          AV_OPT_TYPE_DOUBLE, { .dbl = 2 },    0, DBL_MAX, FLAGS },
+    { "pix_th",   "set the pixel black threshold",                   OFFSET(pixel_black_th),         AV_OPT_TYPE_DOUBLE, { .dbl = .10 },  0, 1,       FLAGS },
+    { "pic_th",   "set the picture black ratio threshold",           OFFSET(picture_black_ratio_th), AV_OPT_TYPE_DOUBLE, { .dbl = .98 },  0, 1,       FLAGS },
+    { "noise",    "set the mean difference below which a picture is frozen", OFFSET(noise),          AV_OPT_TYPE_DOUBLE, { .dbl = .002 }, 0, 1,       FLAGS },
+    { "n",        "set the mean difference below which a picture is frozen", OFFSET(noise),          AV_OPT_TYPE_DOUBLE, { .dbl = .002 }, 0, 1,       FLAGS },
+    { "block_th", "set the blockiness above which a picture is corrupted", OFFSET(block_th),         AV_OPT_TYPE_DOUBLE, { .dbl = .3 },   0, 1,       FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(healthdetect);
+
+#define YUVJ_FORMATS \
+    AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ444P, AV_PIX_FMT_YUVJ440P
+
+static const enum AVPixelFormat yuvj_formats[] = {
+    YUVJ_FORMATS, AV_PIX_FMT_NONE
+};
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_GRAY8,
+        AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+        YUVJ_FORMATS,
+        AV_PIX_FMT_NONE
+    };
+
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    HealthDetectContext *s = ctx->priv;
+    int nb_threads = ff_filter_get_nb_threads(ctx);
+
+    s->duration = s->duration_time / av_q2d(inlink->time_base);
+    s->pixel_black_th_i = ff_fmt_is_in(inlink->format, yuvj_formats) ?
+             s->pixel_black_th *  255 :
+        16 + s->pixel_black_th * (235 - 16);
+
+    s->sw = (inlink->w + s->step - 1) / s->step;
+    s->sh = (inlink->h + s->step - 1) / s->step;
+
+    av_freep(&s->prev);
+    av_freep(&s->job_sums);
+    s->prev     = av_malloc_array(s->sw, s->sh);
+    s->job_sums = av_malloc_array(nb_threads, sizeof(*s->job_sums));
+    if (!s->prev || !s->job_sums)
+        return AVERROR(ENOMEM);
+    s->nb_jobs  = FFMIN(s->sh, nb_threads);
+    s->has_prev = 0;
+
+    av_log(ctx, AV_LOG_VERBOSE, "step:%d duration:%s pixel_black_th_i:%d\n",
+           s->step, av_ts2timestr(s->duration, &inlink->time_base),
+           s->pixel_black_th_i);
+    return 0;
+}
+
+static int measure_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HealthDetectContext *s = ctx->priv;
+    const AVFrame *in = arg;
+    const int w = in->width, step = s->step, sw = s->sw;
+    const int start = (s->sh *  jobnr     ) / nb_jobs;
+    const int end   = (s->sh * (jobnr + 1)) / nb_jobs;
+    const unsigned black_th = s->pixel_black_th_i;
+    HealthSums *sums = &s->job_sums[jobnr];
+    int64_t nb_black = 0, sad = 0, edge = 0, inner = 0;
+    int x, y;
+
+    for (y = start; y < end; y++) {
+        const uint8_t *src = in->data[0] + y * step * in->linesize[0];
+        uint8_t *prev = s->prev + y * sw;
+        int row_black = 0, row_sad = 0, row_edge = 0, row_inner = 0;
+
+        for (x = 0; x < sw; x++) {
+            const int v = src[x * step];
+
+            row_black += v <= black_th;
+            row_sad   += FFABS(v - prev[x]);
+            prev[x]    = v;
+        }
+
+        /* blocking artifacts show as gradients stronger on the 8 pixels
+         * block edges than inside the blocks; the inner gradients are taken
+         * away from the edges of 4x4 blocks too */
+        for (x = 8; x < w - 8; x += 8) {
+            const uint8_t *p = src + x;
+
+            row_edge  += FFABS(p[0] - p[-1]);
+            row_inner += FFABS(p[-2] - p[-3]) + FFABS(p[2] - p[1]);
+        }
+
+        nb_black += row_black;
+        sad      += row_sad;
+        edge     += row_edge;
+        inner    += row_inner;
+    }
+
+    sums->nb_black = nb_black;
+    sums->sad      = sad;
+    sums->edge     = edge;
+    sums->inner    = inner;
+    return 0;
+}
+
+static void update_event(AVFilterContext *ctx, AVFrame *frame, int event, int active)
+{
+    HealthDetectContext *s = ctx->priv;
+    HealthEventState *e = &s->events[event];
+    AVFilterLink *inlink = ctx->inputs[0];
+    const char *name = event_names[event];
+    char key[64];
+
+    if (active) {
+        if (!e->active) {
+            e->active = 1;
+            e->start  = frame->pts;
+        }
+        e->last = frame->pts;
+        if (!e->reported && e->last - e->start >= s->duration) {
+            e->reported = 1;
+            av_log(ctx, AV_LOG_INFO, "%s_start:%s\n", name,
+                   av_ts2timestr(e->start, &inlink->time_base));
+            snprintf(key, sizeof(key), "lavfi.healthdetect.%s_start", name);
+            av_dict_set(&frame->metadata, key,
+                        av_ts2timestr(e->start, &inlink->time_base), 0);
+        }
+    } else if (e->active) {
+        e->active = 0;
+        if (e->reported) {
+            const int64_t end = frame ? frame->pts : e->last;
+
+            e->reported = 0;
+            av_log(ctx, AV_LOG_INFO, "%s_end:%s %s_duration:%s\n",
+                   name, av_ts2timestr(end, &inlink->time_base),
+                   name, av_ts2timestr(end - e->start, &inlink->time_base));
+            if (frame) {
+                snprintf(key, sizeof(key), "lavfi.healthdetect.%s_end", name);
+                av_dict_set(&frame->metadata, key,
+                            av_ts2timestr(end, &inlink->time_base), 0);
+                snprintf(key, sizeof(key), "lavfi.healthdetect.%s_duration", name);
+                av_dict_set(&frame->metadata, key,
+                            av_ts2timestr(end - e->start, &inlink->time_base), 0);
+            }
+        }
+    }
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx = inlink->dst;
+    HealthDetectContext *s = ctx->priv;
+    HealthSums sums = { 0 };
+    double black, mafd, blockiness;
+    int64_t nb_edge;
+    int i;
+
+    ctx->internal->execute(ctx, measure_slice, frame, NULL, s->nb_jobs);
+
+    for (i = 0; i < s->nb_jobs; i++) {
+        sums.nb_black += s->job_sums[i].nb_black;
+        sums.sad      += s->job_sums[i].sad;
+        sums.edge     += s->job_sums[i].edge;
+        sums.inner    += s->job_sums[i].inner;
+    }
+
+    nb_edge    = (int64_t)FFMAX((frame->width - 9) / 8, 0) * s->sh;
+    black      = (double)sums.nb_black / (s->sw * s->sh);
+    mafd       = s->has_prev ? (double)sums.sad / (s->sw * s->sh) : NAN;
+    /* the inner sum has 2 gradients for each edge one */
+    blockiness = nb_edge && sums.edge + sums.inner / 2 ?
+                 av_clipd((double)(sums.edge - sums.inner / 2) /
+                                  (sums.edge + sums.inner / 2), 0, 1) : 0;
+
+    ff_set_meta(&frame->metadata, "lavfi.healthdetect.black", "%f", black);
+    if (s->has_prev) {
+        ff_set_meta(&frame->metadata, "lavfi.healthdetect.mafd", "%f", mafd);
+    }
+    ff_set_meta(&frame->metadata, "lavfi.healthdetect.blockiness", "%f", blockiness);
+
+    av_log(ctx, AV_LOG_DEBUG, "pts:%s black:%f mafd:%f blockiness:%f\n",
+           av_ts2timestr(frame->pts, &inlink->time_base), black, mafd, blockiness);
+
+    update_event(ctx, frame, EVENT_BLACK,  black >= s->picture_black_ratio_th);
+    update_event(ctx, frame, EVENT_FREEZE, s->has_prev && mafd <= s->noise * 255);
+    update_event(ctx, frame, EVENT_BLOCKY, blockiness >= s->block_th);
+
+    s->has_prev = 1;
+    s->last_pts = frame->pts;
+    return ff_filter_frame(ctx->outputs[0], frame);
+}
+
+static int request_frame(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    HealthDetectContext *s = ctx->priv;
+    int ret = ff_request_frame(ctx->inputs[0]);
+    int i;
+
+    if (ret == AVERROR_EOF) {
+        for (i = 0; i < EVENT_NB; i++) {
+            s->events[i].last = s->last_pts;
+            update_event(ctx, NULL, i, 0);
+        }
+    }
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    HealthDetectContext *s = ctx->priv;
+
+    av_freep(&s->prev);
+    av_freep(&s->job_sums);
+}
+
+static const AVFilterPad healthdetect_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad healthdetect_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .request_frame = request_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_healthdetect = {
+    .name          = "healthdetect",
+    .description   = NULL_IF_CONFIG_SMALL("Detect black, frozen and blocky video."),
+    .priv_size     = sizeof(HealthDetectContext),
+    .priv_class    = &healthdetect_class,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = healthdetect_inputs,
+    .outputs       = healthdetect_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -41,6 +41,7 @@
 #include "video.h"
 #include "vf_hqdn3d.h"
 
+#define BAND_LINES 64    ///< luma lines filtered by a job at once
 #define LUT_BITS (depth==16 ? 8 : 4)
 #define LOAD(x) (((depth == 8 ? src[x] : AV_RN16A(src + (x) * 2)) << (16 - depth))\
                  + (((1 << (16 - depth)) - 1) >> 1))
@@ -80,6 +81,7 @@ av_always_inline
 static void denoise_spatial(HQDN3DContext *s,
                             uint8_t *src, uint8_t *dst,
                             uint16_t *line_ant, uint16_t *frame_ant,
+                            const uint16_t *seed, uint16_t *save,
                             int w, int h, int sstride, int dstride,
                             int16_t *spatial, int16_t *temporal, int depth)
 {
@@ -90,16 +92,27 @@ static void denoise_spatial(HQDN3DContext *s,
     spatial  += 256 << LUT_BITS;
     temporal += 256 << LUT_BITS;
 
-    /* First line has no top neighbor. Only left one for each tmp and
-     * last frame */
-    pixel_ant = LOAD(0);
-    for (x = 0; x < w; x++) {
-        line_ant[x] = tmp = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
-        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
-        STORE(x, tmp);
+    if (seed) {
+        /* Band below the top of the plane: the vertical recursion starts
+         * from the line above as it was in the previous frame. */
+        memcpy(line_ant, seed, w * sizeof(*line_ant));
+        src -= sstride;
+        dst -= dstride;
+        frame_ant -= w;
+        y = 0;
+    } else {
+        /* First line has no top neighbor. Only left one for each tmp and
+         * last frame */
+        pixel_ant = LOAD(0);
+        for (x = 0; x < w; x++) {
+            line_ant[x] = tmp = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+            frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
+        }
+        y = 1;
     }
 
-    for (y = 1; y < h; y++) {
+    for (; y < h; y++) {
         src += sstride;
         dst += dstride;
         frame_ant += w;
@@ -118,58 +131,117 @@ static void denoise_spatial(HQDN3DContext *s,
         frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
         STORE(x, tmp);
     }
+
+    if (save)
+        memcpy(save, line_ant, w * sizeof(*line_ant));
 }
 
 av_always_inline
-static int denoise_depth(HQDN3DContext *s,
-                         uint8_t *src, uint8_t *dst,
-                         uint16_t *line_ant, uint16_t **frame_ant_ptr,
-                         int w, int h, int sstride, int dstride,
-                         int16_t *spatial, int16_t *temporal, int depth)
+static void denoise_depth(HQDN3DContext *s,
+                          uint8_t *src, uint8_t *dst,
+                          uint16_t *line_ant, uint16_t *frame_ant,
+                          const uint16_t *seed, uint16_t *save,
+                          int w, int h, int sstride, int dstride,
+                          int16_t *spatial, int16_t *temporal, int depth)
 {
-    // FIXME: For 16-bit depth, frame_ant could be a pointer to the previous
-    // filtered frame rather than a separate buffer.
-    long x, y;
-    uint16_t *frame_ant = *frame_ant_ptr;
-    if (!frame_ant) {
-        uint8_t *frame_src = src;
-        *frame_ant_ptr = frame_ant = av_malloc_array(w, h*sizeof(uint16_t));
-        if (!frame_ant)
-            return AVERROR(ENOMEM);
-        for (y = 0; y < h; y++, src += sstride, frame_ant += w)
-            for (x = 0; x < w; x++)
-                frame_ant[x] = LOAD(x);
-        src = frame_src;
-        frame_ant = *frame_ant_ptr;
-    }
-
     if (spatial[0])
-        denoise_spatial(s, src, dst, line_ant, frame_ant,
+        denoise_spatial(s, src, dst, line_ant, frame_ant, seed, save,
                         w, h, sstride, dstride, spatial, temporal, depth);
     else
         denoise_temporal(src, dst, frame_ant,
                          w, h, sstride, dstride, temporal, depth);
     emms_c();
-    return 0;
 }
 
 #define denoise(...)                                                          \
     do {                                                                      \
-        int ret = AVERROR_BUG;                                                \
         switch (s->depth) {                                                   \
-            case  8: ret = denoise_depth(__VA_ARGS__,  8); break;             \
-            case  9: ret = denoise_depth(__VA_ARGS__,  9); break;             \
-            case 10: ret = denoise_depth(__VA_ARGS__, 10); break;             \
-            case 16: ret = denoise_depth(__VA_ARGS__, 16); break;             \
-        }                                                                     \
-        if (ret < 0) {                                                        \
-            av_frame_free(&out);                                              \
-            if (!direct)                                                      \
-                av_frame_free(&in);                                           \
-            return ret;                                                       \
+            case  8: denoise_depth(__VA_ARGS__,  8); break;                   \
+            case  9: denoise_depth(__VA_ARGS__,  9); break;                   \
+            case 10: denoise_depth(__VA_ARGS__, 10); break;                   \
+            case 16: denoise_depth(__VA_ARGS__, 16); break;                   \
         }                                                                     \
     } while (0)
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int band_lines(HQDN3DContext *s, int c)
+{
+    return BAND_LINES >> (!!c * s->vsub);
+}
+
+/* The vertical recursion of a band starts from the line above it in the
+ * previous frame rather than in the current one, so the bands are
+ * independent and the output does not depend on the number of jobs. */
+static int denoise_bands(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    const int nb_bands = s->nb_bands[0] + s->nb_bands[1] + s->nb_bands[2];
+    int i;
+
+    for (i = jobnr; i < nb_bands; i += nb_jobs) {
+        const int c = (i >= s->nb_bands[0]) + (i >= s->nb_bands[0] + s->nb_bands[1]);
+        const int b = i - (c > 0) * s->nb_bands[0] - (c > 1) * s->nb_bands[1];
+        const int w  = AV_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+        const int h  = AV_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+        const int y0 = b * band_lines(s, c);
+        const int y1 = FFMIN(y0 + band_lines(s, c), h);
+        const uint16_t *seed = s->band_line[c] +  s->band_parity      * s->nb_bands[c] * w;
+        uint16_t       *save = s->band_line[c] + (s->band_parity ^ 1) * s->nb_bands[c] * w;
+
+        denoise(s, in->data[c] + y0 * in->linesize[c],
+                out->data[c] + y0 * out->linesize[c],
+                s->line + jobnr * s->line_size, s->frame_prev[c] + y0 * w,
+                b ? seed + b * w : NULL,
+                b < s->nb_bands[c] - 1 ? save + (b + 1) * w : NULL,
+                w, y1 - y0, in->linesize[c], out->linesize[c],
+                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
+                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    }
+    return 0;
+}
+
+// FIXME: For 16-bit depth, frame_ant could be a pointer to the previous
+// filtered frame rather than a separate buffer.
+static int init_frame_ant(HQDN3DContext *s, AVFrame *in)
+{
+    const int depth = s->depth;
+    int c, x, y;
+
+    for (c = 0; c < 3; c++) {
+        const int w = AV_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+        const int h = AV_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+        const uint8_t *src = in->data[c];
+        uint16_t *frame_ant, *band_line;
+        int b;
+
+        if (s->frame_prev[c])
+            continue;
+        s->frame_prev[c] = frame_ant = av_malloc_array(w, h * sizeof(uint16_t));
+        s->nb_bands[c]   = (h + band_lines(s, c) - 1) / band_lines(s, c);
+        s->band_line[c]  = band_line = av_malloc_array(w, 2 * s->nb_bands[c] * sizeof(uint16_t));
+        if (!frame_ant || !band_line) {
+            av_freep(&s->frame_prev[c]);
+            av_freep(&s->band_line[c]);
+            return AVERROR(ENOMEM);
+        }
+        for (y = 0; y < h; y++, src += in->linesize[c], frame_ant += w)
+            for (x = 0; x < w; x++)
+                frame_ant[x] = LOAD(x);
+        /* the first frame has no line above the bands yet, use the input */
+        for (b = 1; b < s->nb_bands[c]; b++) {
+            frame_ant = s->frame_prev[c] + (b * band_lines(s, c) - 1) * w;
+            memcpy(band_line + b * w, frame_ant, w * sizeof(*band_line));
+        }
+        s->band_parity = 0;
+    }
+    return 0;
+}
+
 static int16_t *precalc_coefs(double dist25, int depth)
 {
     int i;
@@ -227,6 +299,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
+    av_freep(&s->band_line[0]);
+    av_freep(&s->band_line[1]);
+    av_freep(&s->band_line[2]);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -271,7 +346,9 @@ static int config_input(AVFilterLink *inlink)
     s->vsub  = desc->log2_chroma_h;
     s->depth = desc->comp[0].depth;
 
-    s->line = av_malloc_array(inlink->w, sizeof(*s->line));
+    s->nb_threads = ff_filter_get_nb_threads(inlink->dst);
+    s->line_size  = inlink->w;
+    s->line = av_malloc_array(s->line_size * s->nb_threads, sizeof(*s->line));
     if (!s->line)
         return AVERROR(ENOMEM);
 
@@ -293,8 +370,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     HQDN3DContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
 
+    ThreadData td;
     AVFrame *out;
-    int c, direct = av_frame_is_writable(in) && !ctx->is_disabled;
+    int ret, direct;
+
+    direct = av_frame_is_writable(in) && !ctx->is_disabled;
 
     if (direct) {
         out = in;
@@ -308,16 +388,18 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         av_frame_copy_props(out, in);
     }
 
-    for (c = 0; c < 3; c++) {
-        denoise(s, in->data[c], out->data[c],
-                s->line, &s->frame_prev[c],
-                AV_CEIL_RSHIFT(in->width,  (!!c * s->hsub)),
-                AV_CEIL_RSHIFT(in->height, (!!c * s->vsub)),
-                in->linesize[c], out->linesize[c],
-                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
-                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    if ((ret = init_frame_ant(s, in)) < 0) {
+        if (!direct)
+            av_frame_free(&out);
+        av_frame_free(&in);
+        return ret;
     }
 
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, denoise_bands, &td, NULL, s->nb_threads);
+    s->band_parity ^= 1;
+
     if (ctx->is_disabled) {
         av_frame_free(&out);
         return ff_filter_frame(outlink, in);
@@ -370,5 +452,5 @@ AVFilter ff_vf_hqdn3d = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_hqdn3d_inputs,
     .outputs       = avfilter_vf_hqdn3d_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -31,8 +31,13 @@
 typedef struct HQDN3DContext {
     const AVClass *class;
     int16_t *coefs[4];
-    uint16_t *line;
+    uint16_t *line;         ///< one line per job, line_size apart
+    int line_size;
+    int nb_threads;
     uint16_t *frame_prev[3];
+    uint16_t *band_line[3]; ///< line above each band, for the previous and the current frame
+    int nb_bands[3];
+    int band_parity;        ///< which half of band_line holds the previous frame
     double strength[4];
     int hsub, vsub;
     int depth;
@@ -0,0 +1,470 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Mosaic video filter: scale any number of inputs directly into
+ * rectangles of a single output frame.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "drawutils.h"
+#include "formats.h"
+#include "internal.h"
+#include "framesync.h"
+#include "video.h"
+
+/* libswscale output functions may write up to a SIMD register past the end
+ * of a line, in bytes of each plane */
+#define SCALE_OVERWRITE 32
+
+typedef struct MosaicTile {
+    int x, y, w, h;
+    struct SwsContext *sws;
+} MosaicTile;
+
+typedef struct MosaicContext {
+    const AVClass *class;
+    int nb_inputs;
+    int w, h;
+    char *layout;
+    char *flags_str;
+    uint8_t fill_rgba[4];
+    int shortest;
+
+    MosaicTile *tiles;
+    int covered;        ///< the tiles cover the whole output frame
+    int *order;         ///< tile indices, sorted by band and then by x
+    int *band_start;    ///< index in order of the first tile of each band
+    int nb_bands;
+
+    FFDrawContext draw;
+    FFDrawColor fill;
+    int pixstep[4];
+    int hsub, vsub;
+    int overwrite_w;    ///< width in pixels libswscale may write past a tile
+
+    AVFrame **frames;
+    FFFrameSync fs;
+} MosaicContext;
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AVFilterFormats *in_fmts = NULL, *out_fmts = NULL;
+    int fmt, i, ret;
+
+    for (fmt = 0; av_pix_fmt_desc_get(fmt); fmt++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+        FFDrawContext draw;
+
+        if (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)
+            continue;
+        if (sws_isSupportedInput(fmt) &&
+            (ret = ff_add_format(&in_fmts, fmt)) < 0)
+            return ret;
+        if (sws_isSupportedOutput(fmt) && ff_draw_init(&draw, fmt, 0) >= 0 &&
+            (ret = ff_add_format(&out_fmts, fmt)) < 0)
+            return ret;
+    }
+
+    for (i = 0; i < ctx->nb_inputs; i++) {
+        if ((ret = ff_formats_ref(in_fmts, &ctx->inputs[i]->out_formats)) < 0)
+            return ret;
+    }
+    return ff_formats_ref(out_fmts, &ctx->outputs[0]->in_formats);
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MosaicContext *s = ctx->priv;
+    int i, ret;
+
+    s->frames = av_calloc(s->nb_inputs, sizeof(*s->frames));
+    s->tiles  = av_calloc(s->nb_inputs, sizeof(*s->tiles));
+    if (!s->frames || !s->tiles)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        AVFilterPad pad = { 0 };
+
+        pad.type = AVMEDIA_TYPE_VIDEO;
+        pad.name = av_asprintf("input%d", i);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        if ((ret = ff_insert_inpad(ctx, i, &pad)) < 0) {
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_layout(AVFilterContext *ctx)
+{
+    MosaicContext *s = ctx->priv;
+    int i;
+
+    if (!s->layout) {
+        int cols = ceil(sqrt(s->nb_inputs));
+        int rows = (s->nb_inputs + cols - 1) / cols;
+
+        for (i = 0; i < s->nb_inputs; i++) {
+            MosaicTile *t = &s->tiles[i];
+            t->x = (i % cols) * s->w / cols;
+            t->y = (i / cols) * s->h / rows;
+            t->w = (i % cols + 1) * s->w / cols - t->x;
+            t->h = (i / cols + 1) * s->h / rows - t->y;
+        }
+    } else {
+        const char *p = s->layout;
+
+        for (i = 0; i < s->nb_inputs; i++) {
+            MosaicTile *t = &s->tiles[i];
+            int n = 0;
+
+            if (sscanf(p, "%d_%d_%d_%d%n", &t->x, &t->y, &t->w, &t->h, &n) != 4 ||
+                (p[n] && p[n] != '|')) {
+                av_log(ctx, AV_LOG_ERROR, "Invalid layout for input %d: '%s'.\n", i, p);
+                return AVERROR(EINVAL);
+            }
+            p += n + !!p[n];
+            if (i < s->nb_inputs - 1 && !*p) {
+                av_log(ctx, AV_LOG_ERROR, "Layout has %d rectangles, %d inputs.\n",
+                       i + 1, s->nb_inputs);
+                return AVERROR(EINVAL);
+            }
+        }
+    }
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        MosaicTile *t = &s->tiles[i];
+
+        /* keep the rectangle edges aligned on chroma samples */
+        t->w = (t->x + t->w) >> s->hsub << s->hsub;
+        t->h = (t->y + t->h) >> s->vsub << s->vsub;
+        t->x = t->x >> s->hsub << s->hsub;
+        t->y = t->y >> s->vsub << s->vsub;
+        t->w -= t->x;
+        t->h -= t->y;
+        if (t->x < 0 || t->y < 0 || t->w <= 0 || t->h <= 0 ||
+            t->x + t->w > s->w || t->y + t->h > s->h) {
+            av_log(ctx, AV_LOG_ERROR, "Rectangle %dx%d+%d+%d of input %d does not "
+                   "fit in the %dx%d output.\n", t->w, t->h, t->x, t->y, i, s->w, s->h);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    /* the bands and the background filling rely on disjoint rectangles */
+    for (i = 0; i < s->nb_inputs; i++) {
+        const MosaicTile *a = &s->tiles[i];
+        int j;
+
+        for (j = i + 1; j < s->nb_inputs; j++) {
+            const MosaicTile *b = &s->tiles[j];
+            if (a->x < b->x + b->w && b->x < a->x + a->w &&
+                a->y < b->y + b->h && b->y < a->y + a->h) {
+                av_log(ctx, AV_LOG_ERROR, "The rectangles of inputs %d and %d "
+                       "overlap.\n", i, j);
+                return AVERROR(EINVAL);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int cmp_tiles(const MosaicTile *a, const MosaicTile *b, int by_x)
+{
+    return by_x ? a->x - b->x : a->y - b->y;
+}
+
+static void sort_tiles(MosaicContext *s, int *idx, int nb, int by_x)
+{
+    int i, j;
+
+    for (i = 1; i < nb; i++) {
+        int v = idx[i];
+        for (j = i; j > 0 && cmp_tiles(&s->tiles[idx[j - 1]], &s->tiles[v], by_x) > 0; j--)
+            idx[j] = idx[j - 1];
+        idx[j] = v;
+    }
+}
+
+/**
+ * Group the tiles into bands of vertically overlapping tiles. Bands do not
+ * share any line and are processed in parallel, the tiles of a band are
+ * scaled from left to right so that the right neighbour of a tile overwrites
+ * what libswscale may have written past its end.
+ */
+static int build_bands(MosaicContext *s)
+{
+    int64_t area = 0;
+    int i, band_end = -1;
+
+    s->order      = av_malloc_array(s->nb_inputs, sizeof(*s->order));
+    s->band_start = av_malloc_array(s->nb_inputs + 1, sizeof(*s->band_start));
+    if (!s->order || !s->band_start)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        s->order[i] = i;
+        area += (int64_t)s->tiles[i].w * s->tiles[i].h;
+    }
+    /* the rectangles do not overlap, see parse_layout() */
+    s->covered = area == (int64_t)s->w * s->h;
+
+    sort_tiles(s, s->order, s->nb_inputs, 0);
+    s->nb_bands = 0;
+    for (i = 0; i < s->nb_inputs; i++) {
+        const MosaicTile *t = &s->tiles[s->order[i]];
+        if (t->y >= band_end)
+            s->band_start[s->nb_bands++] = i;
+        band_end = FFMAX(band_end, t->y + t->h);
+    }
+    s->band_start[s->nb_bands] = s->nb_inputs;
+
+    for (i = 0; i < s->nb_bands; i++)
+        sort_tiles(s, s->order + s->band_start[i],
+                   s->band_start[i + 1] - s->band_start[i], 1);
+
+    return 0;
+}
+
+static int scale_tiles(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MosaicContext *s = ctx->priv;
+    AVFrame *out = arg;
+    int b, k, p;
+
+    for (b = jobnr; b < s->nb_bands; b += nb_jobs) {
+        for (k = s->band_start[b]; k < s->band_start[b + 1]; k++) {
+            const int i = s->order[k];
+            const MosaicTile *t = &s->tiles[i];
+            const AVFrame *in = s->frames[i];
+            uint8_t *dst[4] = { NULL };
+
+            if (!in) {
+                if (s->covered)
+                    ff_fill_rectangle(&s->draw, &s->fill, out->data, out->linesize,
+                                      t->x, t->y, t->w, t->h);
+                continue;
+            }
+
+            for (p = 0; p < 4 && out->data[p]; p++) {
+                int hsub = p == 1 || p == 2 ? s->hsub : 0;
+                int vsub = p == 1 || p == 2 ? s->vsub : 0;
+
+                dst[p] = out->data[p] + (t->y >> vsub) * out->linesize[p] +
+                                        (t->x >> hsub) * s->pixstep[p];
+            }
+            sws_scale(t->sws, (const uint8_t * const *)in->data, in->linesize,
+                      0, in->height, dst, out->linesize);
+
+            /* restore the background libswscale may have overwritten */
+            if (!s->covered && t->x + t->w < s->w)
+                ff_fill_rectangle(&s->draw, &s->fill, out->data, out->linesize,
+                                  t->x + t->w, t->y,
+                                  FFMIN(s->overwrite_w, s->w - t->x - t->w), t->h);
+        }
+    }
+
+    return 0;
+}
+
+static int process_frame(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    AVFilterLink *outlink = ctx->outputs[0];
+    MosaicContext *s = fs->opaque;
+    AVFrame *out;
+    int i, ret;
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        if ((ret = ff_framesync_get_frame(&s->fs, i, &s->frames[i], 0)) < 0)
+            return ret;
+    }
+
+    out = ff_get_video_buffer(outlink, outlink->w + s->overwrite_w, outlink->h);
+    if (!out)
+        return AVERROR(ENOMEM);
+    out->width = outlink->w;
+    out->pts = av_rescale_q(s->fs.pts, s->fs.time_base, outlink->time_base);
+    out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+
+    if (!s->covered)
+        ff_fill_rectangle(&s->draw, &s->fill, out->data, out->linesize,
+                          0, 0, outlink->w, outlink->h);
+
+    ctx->internal->execute(ctx, scale_tiles, out, NULL,
+                           FFMIN(s->nb_bands, ff_filter_get_nb_threads(ctx)));
+
+    return ff_filter_frame(outlink, out);
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    MosaicContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(outlink->format);
+    FFFrameSyncIn *in;
+    int i, ret;
+
+    s->hsub = desc->log2_chroma_w;
+    s->vsub = desc->log2_chroma_h;
+    av_image_fill_max_pixsteps(s->pixstep, NULL, desc);
+
+    /* a byte of a subsampled plane covers several pixels, a pixel of a
+     * packed plane several bytes */
+    s->overwrite_w = 0;
+    for (i = 0; i < 4 && s->pixstep[i]; i++) {
+        int hsub = i == 1 || i == 2 ? s->hsub : 0;
+        s->overwrite_w = FFMAX(s->overwrite_w,
+                               (SCALE_OVERWRITE + s->pixstep[i] - 1) / s->pixstep[i] << hsub);
+    }
+
+    /* release the state of a previous configuration */
+    for (i = 0; i < s->nb_inputs; i++)
+        sws_freeContext(s->tiles[i].sws);
+    memset(s->tiles, 0, s->nb_inputs * sizeof(*s->tiles));
+    av_freep(&s->order);
+    av_freep(&s->band_start);
+    ff_framesync_uninit(&s->fs);
+
+    if ((ret = ff_draw_init(&s->draw, outlink->format, 0)) < 0)
+        return ret;
+    ff_draw_color(&s->draw, &s->fill, s->fill_rgba);
+
+    if ((ret = parse_layout(ctx)) < 0 ||
+        (ret = build_bands(s)) < 0)
+        return ret;
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        AVFilterLink *inlink = ctx->inputs[i];
+        MosaicTile *t = &s->tiles[i];
+
+        t->sws = sws_alloc_context();
+        if (!t->sws)
+            return AVERROR(ENOMEM);
+
+        av_opt_set_int(t->sws, "srcw", inlink->w, 0);
+        av_opt_set_int(t->sws, "srch", inlink->h, 0);
+        av_opt_set_int(t->sws, "src_format", inlink->format, 0);
+        av_opt_set_int(t->sws, "dstw", t->w, 0);
+        av_opt_set_int(t->sws, "dsth", t->h, 0);
+        av_opt_set_int(t->sws, "dst_format", outlink->format, 0);
+        if ((ret = av_opt_set(t->sws, "sws_flags", s->flags_str, 0)) < 0)
+            return ret;
+        if ((ret = sws_init_context(t->sws, NULL, NULL)) < 0)
+            return ret;
+    }
+
+    outlink->w          = s->w;
+    outlink->h          = s->h;
+    outlink->time_base  = ctx->inputs[0]->time_base;
+    outlink->frame_rate = ctx->inputs[0]->frame_rate;
+    outlink->sample_aspect_ratio = (AVRational){ 1, 1 };
+
+    if ((ret = ff_framesync_init(&s->fs, ctx, s->nb_inputs)) < 0)
+        return ret;
+
+    in = s->fs.in;
+    s->fs.opaque = s;
+    s->fs.on_event = process_frame;
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        AVFilterLink *inlink = ctx->inputs[i];
+
+        in[i].time_base = inlink->time_base;
+        in[i].sync   = 1;
+        in[i].before = EXT_NULL;
+        in[i].after  = s->shortest ? EXT_STOP : EXT_INFINITY;
+    }
+
+    return ff_framesync_configure(&s->fs);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MosaicContext *s = ctx->priv;
+    int i;
+
+    ff_framesync_uninit(&s->fs);
+    av_freep(&s->frames);
+
+    if (s->tiles) {
+        for (i = 0; i < s->nb_inputs; i++)
+            sws_freeContext(s->tiles[i].sws);
+    }
+    av_freep(&s->tiles);
+    av_freep(&s->order);
+    av_freep(&s->band_start);
+
+    for (i = 0; i < ctx->nb_inputs; i++)
+        av_freep(&ctx->input_pads[i].name);
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    MosaicContext *s = ctx->priv;
+    return ff_framesync_activate(&s->fs);
+}
+
+#define OFFSET(x) offsetof(MosaicContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
+static const AVOption mosaic_options[] = {
+    { "inputs",   "set number of inputs", OFFSET(nb_inputs), AV_OPT_TYPE_INT, {.i64=4}, 1, INT_MAX, .flags = FLAGS },
+    { "size",     "set output size", OFFSET(w), AV_OPT_TYPE_IMAGE_SIZE, {.str="hd720"}, 0, 0, .flags = FLAGS },
+    { "s",        "set output size", OFFSET(w), AV_OPT_TYPE_IMAGE_SIZE, {.str="hd720"}, 0, 0, .flags = FLAGS },
+    { "layout",   "set the rectangle of each input as x_y_w_h separated by |", OFFSET(layout), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, .flags = FLAGS },
+    { "fill",     "set the color of the areas not covered by any input", OFFSET(fill_rgba), AV_OPT_TYPE_COLOR, {.str="black"}, 0, 0, .flags = FLAGS },
+    { "flags",    "set libswscale scaling flags", OFFSET(flags_str), AV_OPT_TYPE_STRING, {.str="bilinear"}, 0, 0, .flags = FLAGS },
+    { "shortest", "force termination when the shortest input terminates", OFFSET(shortest), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, .flags = FLAGS },
+    { NULL },
+};
+
+AVFILTER_DEFINE_CLASS(mosaic);
+
+static const AVFilterPad outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_mosaic = {
+    .name          = "mosaic",
+    .description   = NULL_IF_CONFIG_SMALL("Scale video inputs into the rectangles of a mosaic."),
+    .priv_size     = sizeof(MosaicContext),
+    .priv_class    = &mosaic_class,
+    .query_formats = query_formats,
+    .outputs       = outputs,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
+};
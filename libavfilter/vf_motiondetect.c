@@ -0,0 +1,432 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Motion detection on a decimated luma plane against a running background.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "avfilter.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+#define MAX_ZONES 8
+
+typedef struct MotionZone {
+    int x, y, w, h;
+} MotionZone;
+
+typedef struct MotionStats {
+    int changed;            ///< number of changed cells
+    int x1, y1, x2, y2;     ///< bounding box of the changed cells, in cells
+} MotionStats;
+
+typedef struct MotionDetectContext {
+    const AVClass *class;
+    int factor;
+    int threshold;
+    double rate;
+    double amount;
+    char *zones_str;
+    char *exclude_str;
+
+    MotionZone zones[MAX_ZONES];
+    int nb_zones;
+    MotionZone excludes[MAX_ZONES];
+    int nb_excludes;
+
+    int log2_factor;
+    int cw, ch;             ///< size of the decimated plane, in cells
+    int weight;             ///< background update weight, in 1/256
+    uint16_t *mask;         ///< bit z set if the cell is in area z
+    uint16_t *bg;           ///< background, 8.8 fixed point
+    int has_bg;
+    int nb_areas;           ///< number of areas, 0 is the whole watched surface
+    int *area_cells;        ///< number of cells in each area
+
+    int nb_jobs;
+    uint32_t *job_acc;      ///< cw sums per job
+    MotionStats *job_stats; ///< nb_areas stats per job
+} MotionDetectContext;
+
+#define OFFSET(x) offsetof(MotionDetectContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption motiondetect_options[] = {
+    { "factor",    "set the decimation factor",                OFFSET(factor),      AV_OPT_TYPE_INT,    { .i64 = 4 },     1, 16, FLAGS },
+    { "threshold", "set the cell difference threshold",        OFFSET(threshold),   AV_OPT_TYPE_INT,    { .i64 = 16 },    0, 255, FLAGS },
+    { "rate",      "set the background learning rate",         OFFSET(rate),        AV_OPT_TYPE_DOUBLE, { .dbl = 0.05 },  0, 1, FLAGS },
+    { "amount",    "set the fraction of changed cells for motion", OFFSET(amount),  AV_OPT_TYPE_DOUBLE, { .dbl = 0.002 }, 0, 1, FLAGS },
+    { "zones",     "set the zones to watch",                   OFFSET(zones_str),   AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, FLAGS },
+    { "exclude",   "set the zones to ignore",                  OFFSET(exclude_str), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(motiondetect);
+
+static int parse_zones(AVFilterContext *ctx, const char *str,
+                       MotionZone *zones, int *nb_zones)
+{
+    const char *p = str;
+
+    *nb_zones = 0;
+    if (!str)
+        return 0;
+
+    while (*p) {
+        MotionZone *z = &zones[*nb_zones];
+        int n = 0;
+
+        if (*nb_zones == MAX_ZONES) {
+            av_log(ctx, AV_LOG_ERROR, "Too many zones, at most %d are supported.\n",
+                   MAX_ZONES);
+            return AVERROR(EINVAL);
+        }
+        if (sscanf(p, "%d_%d_%d_%d%n", &z->x, &z->y, &z->w, &z->h, &n) != 4 ||
+            (p[n] && p[n] != '|') || z->x < 0 || z->y < 0 || z->w <= 0 || z->h <= 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid zone '%s'.\n", p);
+            return AVERROR(EINVAL);
+        }
+        (*nb_zones)++;
+        p += n + !!p[n];
+    }
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MotionDetectContext *s = ctx->priv;
+    int ret;
+
+    if (s->factor & (s->factor - 1)) {
+        av_log(ctx, AV_LOG_ERROR, "The decimation factor must be a power of 2.\n");
+        return AVERROR(EINVAL);
+    }
+    s->log2_factor = av_log2(s->factor);
+
+    if ((ret = parse_zones(ctx, s->zones_str,   s->zones,    &s->nb_zones))    < 0 ||
+        (ret = parse_zones(ctx, s->exclude_str, s->excludes, &s->nb_excludes)) < 0)
+        return ret;
+
+    s->nb_areas = 1 + s->nb_zones;
+    s->weight   = lrint(s->rate * 256);
+    return 0;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_GRAY8,
+        AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P, AV_PIX_FMT_YUV420P,
+        AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P,
+        AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
+        AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P, AV_PIX_FMT_YUVA444P,
+        AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+        AV_PIX_FMT_NONE
+    };
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int in_zone(const MotionZone *z, int x, int y)
+{
+    return x >= z->x && x < z->x + z->w && y >= z->y && y < z->y + z->h;
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    MotionDetectContext *s = ctx->priv;
+    int nb_threads = ff_filter_get_nb_threads(ctx);
+    int x, y, i;
+
+    s->cw = inlink->w >> s->log2_factor;
+    s->ch = inlink->h >> s->log2_factor;
+    if (!s->cw || !s->ch) {
+        av_log(ctx, AV_LOG_ERROR, "Input is too small for a decimation factor of %d.\n",
+               s->factor);
+        return AVERROR(EINVAL);
+    }
+
+    av_freep(&s->mask);
+    av_freep(&s->bg);
+    av_freep(&s->area_cells);
+    av_freep(&s->job_acc);
+    av_freep(&s->job_stats);
+    s->mask       = av_malloc_array(s->cw * s->ch, sizeof(*s->mask));
+    s->bg         = av_malloc_array(s->cw * s->ch, sizeof(*s->bg));
+    s->area_cells = av_calloc(s->nb_areas, sizeof(*s->area_cells));
+    s->job_acc    = av_malloc_array(nb_threads * s->cw, sizeof(*s->job_acc));
+    s->job_stats  = av_malloc_array(nb_threads * s->nb_areas, sizeof(*s->job_stats));
+    if (!s->mask || !s->bg || !s->area_cells || !s->job_acc || !s->job_stats)
+        return AVERROR(ENOMEM);
+    s->nb_jobs = FFMIN(s->ch, nb_threads);
+    s->has_bg  = 0;
+
+    /* a cell belongs to the areas containing its center */
+    for (y = 0; y < s->ch; y++) {
+        for (x = 0; x < s->cw; x++) {
+            const int px = (x << s->log2_factor) + s->factor / 2;
+            const int py = (y << s->log2_factor) + s->factor / 2;
+            int m = !s->nb_zones;
+
+            for (i = 0; i < s->nb_zones; i++)
+                if (in_zone(&s->zones[i], px, py))
+                    m |= 1 | 2 << i;
+            for (i = 0; i < s->nb_excludes; i++)
+                if (in_zone(&s->excludes[i], px, py))
+                    m = 0;
+            for (i = 0; i < s->nb_areas; i++)
+                s->area_cells[i] += m >> i & 1;
+            s->mask[y * s->cw + x] = m;
+        }
+    }
+    return 0;
+}
+
+static void update_stats(MotionStats *st, int x, int y)
+{
+    if (!st->changed++) {
+        st->x1 = st->x2 = x;
+        st->y1 = st->y2 = y;
+    } else {
+        st->x1 = FFMIN(st->x1, x);
+        st->x2 = FFMAX(st->x2, x);
+        st->y2 = y;
+    }
+}
+
+#define LANES 0x00ff00ff00ff00ffULL
+
+/* Sum the bytes of a word in 4 lanes of 16 bits, which can accumulate up
+ * to 128 words without overflow. The word is loaded little-endian so that
+ * lane n always holds bytes 2n and 2n+1. */
+static av_always_inline uint64_t add_word(uint64_t s, const uint8_t *p)
+{
+    const uint64_t v = AV_RL64(p);
+    return s + (v & LANES) + (v >> 8 & LANES);
+}
+
+static void decimate_row(uint32_t *acc, const uint8_t *src, ptrdiff_t linesize,
+                         int f, int cw)
+{
+    int x, j, k;
+
+    if (f == 2) {
+        /* each word holds 4 blocks */
+        for (x = 0; x < cw - 3; x += 4) {
+            const uint64_t s = add_word(add_word(0, src + 2 * x), src + 2 * x + linesize);
+
+            acc[x    ] = s       & 0xffff;
+            acc[x + 1] = s >> 16 & 0xffff;
+            acc[x + 2] = s >> 32 & 0xffff;
+            acc[x + 3] = s >> 48;
+        }
+    } else if (f == 4) {
+        /* each word holds 2 blocks */
+        for (x = 0; x < cw - 1; x += 2) {
+            const uint8_t *p = src + 4 * x;
+            uint64_t s = 0;
+
+            for (k = 0; k < 4; k++, p += linesize)
+                s = add_word(s, p);
+            acc[x    ] = (s       & 0xffff) + (s >> 16 & 0xffff);
+            acc[x + 1] = (s >> 32 & 0xffff) + (s >> 48);
+        }
+    } else if (f >= 8) {
+        for (x = 0; x < cw; x++) {
+            const uint8_t *p = src + f * x;
+            uint64_t s = 0;
+
+            for (k = 0; k < f; k++, p += linesize)
+                for (j = 0; j < f; j += 8)
+                    s = add_word(s, p + j);
+            acc[x] = (s & 0xffff) + (s >> 16 & 0xffff) +
+                     (s >> 32 & 0xffff) + (s >> 48);
+        }
+    } else {
+        x = 0;
+    }
+
+    for (; x < cw; x++) {
+        const uint8_t *p = src + f * x;
+        int sum = 0;
+
+        for (k = 0; k < f; k++, p += linesize)
+            for (j = 0; j < f; j++)
+                sum += p[j];
+        acc[x] = sum;
+    }
+}
+
+static int detect_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MotionDetectContext *s = ctx->priv;
+    const AVFrame *in = arg;
+    const int cw = s->cw;
+    const int shift = 2 * s->log2_factor;
+    const int round = (1 << shift) >> 1;
+    const int start = (s->ch *  jobnr     ) / nb_jobs;
+    const int end   = (s->ch * (jobnr + 1)) / nb_jobs;
+    uint32_t *acc = s->job_acc + jobnr * cw;
+    MotionStats *stats = s->job_stats + jobnr * s->nb_areas;
+    int x, y, i;
+
+    memset(stats, 0, s->nb_areas * sizeof(*stats));
+
+    for (y = start; y < end; y++) {
+        const uint8_t *src = in->data[0] + (y << s->log2_factor) * in->linesize[0];
+        const uint16_t *mask = s->mask + y * cw;
+        uint16_t *bg = s->bg + y * cw;
+
+        /* decimate by averaging blocks of f x f pixels */
+        decimate_row(acc, src, in->linesize[0], s->factor, cw);
+
+        if (!s->has_bg) {
+            for (x = 0; x < cw; x++)
+                bg[x] = (acc[x] + round) >> shift << 8;
+            continue;
+        }
+
+        for (x = 0; x < cw; x++) {
+            const int v = (acc[x] + round) >> shift;
+            const int b = bg[x];
+
+            if (FFABS(v - (b >> 8)) > s->threshold && mask[x]) {
+                const int m = mask[x];
+
+                update_stats(&stats[0], x, y);
+                for (i = 1; i < s->nb_areas; i++)
+                    if (m >> i & 1)
+                        update_stats(&stats[i], x, y);
+            }
+            bg[x] = b + (((v << 8) - b) * s->weight >> 8);
+        }
+    }
+    return 0;
+}
+
+static void export_area(MotionDetectContext *s, AVDictionary **metadata,
+                        const char *prefix, const MotionStats *st, int cells)
+{
+    const double score = cells ? (double)st->changed / cells : 0;
+    const int motion = st->changed && score >= s->amount;
+    char key[64];
+
+    snprintf(key, sizeof(key), "lavfi.motiondetect.%sscore", prefix);
+    ff_set_meta(metadata, key, "%f", score);
+    snprintf(key, sizeof(key), "lavfi.motiondetect.%smotion", prefix);
+    ff_set_meta(metadata, key, "%d", motion);
+    if (motion) {
+        snprintf(key, sizeof(key), "lavfi.motiondetect.%sx1", prefix);
+        ff_set_meta(metadata, key, "%d", st->x1 << s->log2_factor);
+        snprintf(key, sizeof(key), "lavfi.motiondetect.%sy1", prefix);
+        ff_set_meta(metadata, key, "%d", st->y1 << s->log2_factor);
+        snprintf(key, sizeof(key), "lavfi.motiondetect.%sx2", prefix);
+        ff_set_meta(metadata, key, "%d", ((st->x2 + 1) << s->log2_factor) - 1);
+        snprintf(key, sizeof(key), "lavfi.motiondetect.%sy2", prefix);
+        ff_set_meta(metadata, key, "%d", ((st->y2 + 1) << s->log2_factor) - 1);
+    }
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    MotionDetectContext *s = ctx->priv;
+    int i, j;
+
+    ctx->internal->execute(ctx, detect_slice, in, NULL, s->nb_jobs);
+
+    if (s->has_bg) {
+        for (i = 0; i < s->nb_areas; i++) {
+            MotionStats *st = &s->job_stats[i];
+            char prefix[16] = "";
+
+            for (j = 1; j < s->nb_jobs; j++) {
+                const MotionStats *js = &s->job_stats[j * s->nb_areas + i];
+
+                if (!js->changed)
+                    continue;
+                if (!st->changed) {
+                    *st = *js;
+                    continue;
+                }
+                st->changed += js->changed;
+                st->x1 = FFMIN(st->x1, js->x1);
+                st->x2 = FFMAX(st->x2, js->x2);
+                st->y2 = js->y2;
+            }
+            if (i)
+                snprintf(prefix, sizeof(prefix), "zone%d.", i - 1);
+            export_area(s, &in->metadata, prefix, st, s->area_cells[i]);
+        }
+    }
+    s->has_bg = 1;
+
+    return ff_filter_frame(ctx->outputs[0], in);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MotionDetectContext *s = ctx->priv;
+
+    av_freep(&s->mask);
+    av_freep(&s->bg);
+    av_freep(&s->area_cells);
+    av_freep(&s->job_acc);
+    av_freep(&s->job_stats);
+}
+
+static const AVFilterPad motiondetect_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad motiondetect_outputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_motiondetect = {
+    .name          = "motiondetect",
+    .description   = NULL_IF_CONFIG_SMALL("Detect motion against a background model."),
+    .priv_size     = sizeof(MotionDetectContext),
+    .priv_class    = &motiondetect_class,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = motiondetect_inputs,
+    .outputs       = motiondetect_outputs,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -640,6 +640,7 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags_internal  = FF_FILTER_FLAG_KEEPS_TIMESTAMPS,
 };
 
 static const AVClass scale2ref_class = {
@@ -0,0 +1,373 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Sprite sheet generator: scale sparse frames directly into the cells of
+ * a grid, and index the cells in a WebVTT file.
+ */
+
+#include <inttypes.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavformat/avformat.h"
+#include "libswscale/swscale.h"
+#include "avfilter.h"
+#include "drawutils.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+/* size of the file names of the sheets, the cue text adds the cell location */
+#define MAX_NAME_SIZE 1024
+
+/* libswscale output functions may write up to a SIMD register past the end
+ * of a line, in bytes of each plane */
+#define SCALE_OVERWRITE 32
+
+typedef struct SpriteSheetContext {
+    const AVClass *class;
+    unsigned nb_x, nb_y;        ///< grid size, in cells
+    int cell_w, cell_h;         ///< size of a cell
+    int64_t interval;           ///< minimal time between two thumbnails
+    int margin, padding;
+    uint8_t rgba_color[4];
+    char *vtt_str;              ///< WebVTT file to write
+    char *pattern;              ///< file name pattern of the sheets
+    int start_number;           ///< number of the first sheet
+
+    unsigned nb_cells;
+    unsigned current;           ///< cell to fill in the current sheet
+    int sheet;                  ///< number of the current sheet
+    AVFrame *out;               ///< sheet being filled
+    struct SwsContext *sws;
+    FFDrawContext draw;
+    FFDrawColor blank;
+    const AVPixFmtDescriptor *desc;
+    int overwrite_w;            ///< width in pixels libswscale may write past a cell
+    int64_t next_time;          ///< time of the next thumbnail, in AV_TIME_BASE
+
+    AVIOContext *vtt;
+    int64_t cue_start;          ///< pending cue, AV_NOPTS_VALUE if none
+    int64_t last_delta;
+    char cue_text[MAX_NAME_SIZE + sizeof("#xywh=") + 4 * 11 + 3];
+} SpriteSheetContext;
+
+#define OFFSET(x) offsetof(SpriteSheetContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption spritesheet_options[] = {
+    { "layout",       "set grid size",                     OFFSET(nb_x),         AV_OPT_TYPE_IMAGE_SIZE, {.str = "5x5"},     0, 0,         FLAGS },
+    { "size",         "set cell size",                     OFFSET(cell_w),       AV_OPT_TYPE_IMAGE_SIZE, {.str = "160x90"},  0, 0,         FLAGS },
+    { "s",            "set cell size",                     OFFSET(cell_w),       AV_OPT_TYPE_IMAGE_SIZE, {.str = "160x90"},  0, 0,         FLAGS },
+    { "interval",     "set minimal time between thumbnails", OFFSET(interval),   AV_OPT_TYPE_DURATION,   {.i64 = 10000000},  0, INT64_MAX, FLAGS },
+    { "margin",       "set outer border margin in pixels", OFFSET(margin),       AV_OPT_TYPE_INT,        {.i64 = 0},         0, 1024,      FLAGS },
+    { "padding",      "set inner border thickness in pixels", OFFSET(padding),   AV_OPT_TYPE_INT,        {.i64 = 0},         0, 1024,      FLAGS },
+    { "color",        "set the color of the unused area",  OFFSET(rgba_color),   AV_OPT_TYPE_COLOR,      {.str = "black"},   0, 0,         FLAGS },
+    { "vtt",          "set WebVTT index file",             OFFSET(vtt_str),      AV_OPT_TYPE_STRING,     {.str = NULL},      0, 0,         FLAGS },
+    { "pattern",      "set file name pattern of the sheets", OFFSET(pattern),    AV_OPT_TYPE_STRING,     {.str = "sheet%03d.jpg"}, 0, 0,   FLAGS },
+    { "start_number", "set number of the first sheet",     OFFSET(start_number), AV_OPT_TYPE_INT,        {.i64 = 1},         0, INT_MAX,   FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(spritesheet);
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    SpriteSheetContext *s = ctx->priv;
+
+    if (s->nb_x > UINT_MAX / s->nb_y) {
+        av_log(ctx, AV_LOG_ERROR, "Grid size %ux%u is insane.\n", s->nb_x, s->nb_y);
+        return AVERROR(EINVAL);
+    }
+    s->nb_cells   = s->nb_x * s->nb_y;
+    s->sheet      = s->start_number;
+    s->next_time  = AV_NOPTS_VALUE;
+    s->cue_start  = AV_NOPTS_VALUE;
+    return 0;
+}
+
+/* The index is only opened with the first thumbnail, so that a filter
+ * which is initialized but never used does not create or truncate it. */
+static int open_vtt(AVFilterContext *ctx)
+{
+    SpriteSheetContext *s = ctx->priv;
+    int ret;
+
+    if (!strcmp("-", s->vtt_str))
+        ret = avio_open(&s->vtt, "pipe:1", AVIO_FLAG_WRITE);
+    else
+        ret = avio_open(&s->vtt, s->vtt_str, AVIO_FLAG_WRITE);
+    if (ret < 0) {
+        char buf[128];
+        av_strerror(ret, buf, sizeof(buf));
+        av_log(ctx, AV_LOG_ERROR, "Could not open %s: %s\n", s->vtt_str, buf);
+        return ret;
+    }
+    avio_printf(s->vtt, "WEBVTT\n");
+    return 0;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ444P,
+        AV_PIX_FMT_YUV420P,  AV_PIX_FMT_YUV422P,  AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_GRAY8,    AV_PIX_FMT_RGB24,    AV_PIX_FMT_BGR24,
+        AV_PIX_FMT_RGBA,     AV_PIX_FMT_BGRA,     AV_PIX_FMT_NONE
+    };
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int config_props(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    SpriteSheetContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const int64_t w = (int64_t)s->nb_x * (s->cell_w + s->padding) - s->padding + 2 * s->margin;
+    const int64_t h = (int64_t)s->nb_y * (s->cell_h + s->padding) - s->padding + 2 * s->margin;
+    int i, ret;
+
+    s->desc = av_pix_fmt_desc_get(outlink->format);
+    if ((s->cell_w | s->padding | s->margin) & ((1 << s->desc->log2_chroma_w) - 1) ||
+        (s->cell_h | s->padding | s->margin) & ((1 << s->desc->log2_chroma_h) - 1)) {
+        av_log(ctx, AV_LOG_ERROR, "Cell size, padding and margin must be multiples "
+               "of the chroma subsampling of %s.\n", s->desc->name);
+        return AVERROR(EINVAL);
+    }
+    if ((ret = av_image_check_size(w, h, 0, ctx)) < 0)
+        return ret;
+
+    outlink->w = w;
+    outlink->h = h;
+    outlink->sample_aspect_ratio = (AVRational){ 1, 1 };
+    if (s->interval)
+        outlink->frame_rate = av_d2q(AV_TIME_BASE / ((double)s->interval * s->nb_cells), INT_MAX);
+    else
+        outlink->frame_rate = av_mul_q(inlink->frame_rate, av_make_q(1, s->nb_cells));
+    ff_draw_init(&s->draw, outlink->format, 0);
+    ff_draw_color(&s->draw, &s->blank, s->rgba_color);
+
+    s->overwrite_w = 0;
+    for (i = 0; i < s->draw.nb_planes; i++)
+        s->overwrite_w = FFMAX(s->overwrite_w,
+                               (SCALE_OVERWRITE + s->draw.pixelstep[i] - 1) /
+                               s->draw.pixelstep[i] << s->draw.hsub[i]);
+
+    return 0;
+}
+
+static void get_cell_pos(SpriteSheetContext *s, unsigned cell, int *x, int *y)
+{
+    *x = s->margin + (s->cell_w + s->padding) * (cell % s->nb_x);
+    *y = s->margin + (s->cell_h + s->padding) * (cell / s->nb_x);
+}
+
+static void print_time(AVIOContext *pb, int64_t t)
+{
+    int64_t ms = av_rescale(FFMAX(t, 0), 1000, AV_TIME_BASE);
+
+    avio_printf(pb, "%02"PRId64":%02d:%02d.%03d", ms / 3600000,
+                (int)(ms / 60000 % 60), (int)(ms / 1000 % 60), (int)(ms % 1000));
+}
+
+static void write_cue(SpriteSheetContext *s, int64_t end)
+{
+    if (!s->vtt || s->cue_start == AV_NOPTS_VALUE)
+        return;
+    avio_printf(s->vtt, "\n");
+    print_time(s->vtt, s->cue_start);
+    avio_printf(s->vtt, " --> ");
+    print_time(s->vtt, end);
+    avio_printf(s->vtt, "\n%s\n", s->cue_text);
+    s->cue_start = AV_NOPTS_VALUE;
+}
+
+static int end_sheet(AVFilterContext *ctx)
+{
+    SpriteSheetContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *out = s->out;
+    int x, y;
+
+    for (; s->current < s->nb_cells; s->current++) {
+        get_cell_pos(s, s->current, &x, &y);
+        ff_fill_rectangle(&s->draw, &s->blank, out->data, out->linesize,
+                          x, y, s->cell_w, s->cell_h);
+    }
+    s->out     = NULL;
+    s->current = 0;
+    s->sheet++;
+    return ff_filter_frame(outlink, out);
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx  = inlink->dst;
+    SpriteSheetContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    uint8_t *dst[4] = { NULL };
+    int64_t t;
+    int i, x, y, ret;
+
+    if (in->pts == AV_NOPTS_VALUE) {
+        av_frame_free(&in);
+        return 0;
+    }
+    if (s->vtt_str && !s->vtt && (ret = open_vtt(ctx)) < 0) {
+        av_frame_free(&in);
+        return ret;
+    }
+    t = av_rescale_q(in->pts, inlink->time_base, AV_TIME_BASE_Q);
+    if (s->next_time != AV_NOPTS_VALUE && t < s->next_time) {
+        av_frame_free(&in);
+        return 0;
+    }
+    /* stay on a grid of the interval, whatever the times of the frames */
+    if (s->next_time == AV_NOPTS_VALUE || !s->interval)
+        s->next_time = t;
+    while (s->interval && s->next_time <= t)
+        s->next_time += s->interval;
+
+    s->sws = sws_getCachedContext(s->sws, in->width, in->height, in->format,
+                                  s->cell_w, s->cell_h, outlink->format,
+                                  SWS_BILINEAR, NULL, NULL, NULL);
+    if (!s->sws) {
+        av_frame_free(&in);
+        return AVERROR(EINVAL);
+    }
+
+    if (!s->out) {
+        s->out = ff_get_video_buffer(outlink, outlink->w + s->overwrite_w, outlink->h);
+        if (!s->out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        av_frame_copy_props(s->out, in);
+        s->out->width  = outlink->w;
+        s->out->height = outlink->h;
+        s->out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+        if (s->margin || s->padding)
+            ff_fill_rectangle(&s->draw, &s->blank, s->out->data, s->out->linesize,
+                              0, 0, outlink->w, outlink->h);
+    }
+
+    /* scale directly into the cell */
+    get_cell_pos(s, s->current, &x, &y);
+    for (i = 0; i < 4 && s->out->data[i]; i++) {
+        const int chroma = (i == 1 || i == 2) && !(s->desc->flags & AV_PIX_FMT_FLAG_RGB);
+        const int hsub = chroma ? s->desc->log2_chroma_w : 0;
+        const int vsub = chroma ? s->desc->log2_chroma_h : 0;
+
+        dst[i] = s->out->data[i] + (y >> vsub) * s->out->linesize[i] +
+                 (x >> hsub) * s->draw.pixelstep[i];
+    }
+    sws_scale(s->sws, (const uint8_t * const *)in->data, in->linesize,
+              0, in->height, dst, s->out->linesize);
+    av_frame_free(&in);
+
+    /* restore the padding or margin libswscale may have overwritten, the
+     * following cells are scaled afterwards */
+    if ((s->margin || s->padding) && x + s->cell_w < outlink->w)
+        ff_fill_rectangle(&s->draw, &s->blank, s->out->data, s->out->linesize,
+                          x + s->cell_w, y,
+                          FFMIN(s->overwrite_w, outlink->w - x - s->cell_w), s->cell_h);
+
+    if (s->cue_start != AV_NOPTS_VALUE) {
+        s->last_delta = t - s->cue_start;
+        write_cue(s, t);
+    }
+    if (s->vtt) {
+        char name[MAX_NAME_SIZE];
+
+        if (av_get_frame_filename2(name, sizeof(name), s->pattern, s->sheet,
+                                   AV_FRAME_FILENAME_FLAGS_MULTIPLE) < 0)
+            av_strlcpy(name, s->pattern, sizeof(name));
+        snprintf(s->cue_text, sizeof(s->cue_text), "%s#xywh=%d,%d,%d,%d",
+                 name, x, y, s->cell_w, s->cell_h);
+        s->cue_start = t;
+    }
+
+    if (++s->current == s->nb_cells)
+        return end_sheet(ctx);
+    return 0;
+}
+
+static int request_frame(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx  = outlink->src;
+    SpriteSheetContext *s = ctx->priv;
+    int ret;
+
+    ret = ff_request_frame(ctx->inputs[0]);
+    if (ret == AVERROR_EOF && s->out)
+        ret = end_sheet(ctx);
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    SpriteSheetContext *s = ctx->priv;
+
+    if (s->cue_start != AV_NOPTS_VALUE)
+        write_cue(s, s->cue_start + (s->interval ? s->interval : s->last_delta));
+    if (s->vtt) {
+        avio_flush(s->vtt);
+        avio_closep(&s->vtt);
+    }
+    av_frame_free(&s->out);
+    sws_freeContext(s->sws);
+    s->sws = NULL;
+}
+
+static const AVFilterPad spritesheet_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad spritesheet_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_props,
+        .request_frame = request_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_spritesheet = {
+    .name          = "spritesheet",
+    .description   = NULL_IF_CONFIG_SMALL("Scale sparse frames into the cells of sprite sheets."),
+    .priv_size     = sizeof(SpriteSheetContext),
+    .priv_class    = &spritesheet_class,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = spritesheet_inputs,
+    .outputs       = spritesheet_outputs,
+};
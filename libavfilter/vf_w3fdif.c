@@ -37,7 +37,6 @@ typedef struct W3FDIFContext {
     int deint;            ///< which frames to deinterlace
     int linesize[4];      ///< bytes of pixel data per line for each plane
     int planeheight[4];   ///< height of each plane
-    int field;            ///< which field are we on, 0 or 1
     int eof;
     int nb_planes;
     AVFrame *prev, *cur, *next;  ///< previous, current, next frames
@@ -336,18 +335,13 @@ static const int16_t coef_hf[2][5] = {{ -2048,  4096, -2048,     0,    0},
                                       {  1016, -3801,  5570, -3801, 1016}};
 
 typedef struct ThreadData {
-    AVFrame *out, *cur, *adj;
-    int plane;
+    AVFrame *out[2], *cur, *adj[2];
 } ThreadData;
 
-static int deinterlace_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void deinterlace_plane_slice(W3FDIFContext *s, AVFrame *out,
+                                    AVFrame *cur, AVFrame *adj,
+                                    int field, int plane, int jobnr, int nb_jobs)
 {
-    W3FDIFContext *s = ctx->priv;
-    ThreadData *td = arg;
-    AVFrame *out = td->out;
-    AVFrame *cur = td->cur;
-    AVFrame *adj = td->adj;
-    const int plane = td->plane;
     const int filter = s->filter;
     uint8_t *in_line, *in_lines_cur[5], *in_lines_adj[5];
     uint8_t *out_line, *out_pixel;
@@ -366,7 +360,7 @@ static int deinterlace_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_
     int j, y_in, y_out;
 
     /* copy unchanged the lines of the field */
-    y_out = start + ((s->field == cur->top_field_first) ^ (start & 1));
+    y_out = start + ((field == cur->top_field_first) ^ (start & 1));
 
     in_line  = cur_data + (y_out * cur_line_stride);
     out_line = dst_data + (y_out * dst_line_stride);
@@ -379,7 +373,7 @@ static int deinterlace_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_
     }
 
     /* interpolate other lines of the field */
-    y_out = start + ((s->field != cur->top_field_first) ^ (start & 1));
+    y_out = start + ((field != cur->top_field_first) ^ (start & 1));
 
     out_line = dst_data + (y_out * dst_line_stride);
 
@@ -441,55 +435,70 @@ static int deinterlace_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_
         y_out += 2;
         out_line += dst_line_stride * 2;
     }
+}
+
+static int deinterlace_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    W3FDIFContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int field, plane;
+
+    /* both fields are interpolated from the same lines of the current frame,
+     * so they are done together while these lines are in the cache */
+    for (plane = 0; plane < s->nb_planes; plane++)
+        for (field = 0; field < 2; field++)
+            deinterlace_plane_slice(s, td->out[field], td->cur, td->adj[field],
+                                    field, plane, jobnr, nb_jobs);
 
     return 0;
 }
 
-static int filter(AVFilterContext *ctx, int is_second)
+static int filter(AVFilterContext *ctx)
 {
     W3FDIFContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
-    AVFrame *out, *adj;
     ThreadData td;
-    int plane;
-
-    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-    if (!out)
-        return AVERROR(ENOMEM);
-    av_frame_copy_props(out, s->cur);
-    out->interlaced_frame = 0;
-
-    if (!is_second) {
-        if (out->pts != AV_NOPTS_VALUE)
-            out->pts *= 2;
-    } else {
-        int64_t cur_pts  = s->cur->pts;
-        int64_t next_pts = s->next->pts;
-
-        if (next_pts != AV_NOPTS_VALUE && cur_pts != AV_NOPTS_VALUE) {
-            out->pts = cur_pts + next_pts;
-        } else {
-            out->pts = AV_NOPTS_VALUE;
+    int64_t cur_pts  = s->cur->pts;
+    int64_t next_pts = s->next->pts;
+    int i, ret;
+
+    for (i = 0; i < 2; i++) {
+        td.out[i] = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!td.out[i]) {
+            if (i)
+                av_frame_free(&td.out[0]);
+            return AVERROR(ENOMEM);
         }
+        av_frame_copy_props(td.out[i], s->cur);
+        td.out[i]->interlaced_frame = 0;
     }
 
-    adj = s->field ? s->next : s->prev;
-    td.out = out; td.cur = s->cur; td.adj = adj;
-    for (plane = 0; plane < s->nb_planes; plane++) {
-        td.plane = plane;
-        ctx->internal->execute(ctx, deinterlace_slice, &td, NULL, FFMIN(s->planeheight[plane], s->nb_threads));
+    if (td.out[0]->pts != AV_NOPTS_VALUE)
+        td.out[0]->pts *= 2;
+    if (next_pts != AV_NOPTS_VALUE && cur_pts != AV_NOPTS_VALUE) {
+        td.out[1]->pts = cur_pts + next_pts;
+    } else {
+        td.out[1]->pts = AV_NOPTS_VALUE;
     }
 
-    s->field = !s->field;
+    td.cur    = s->cur;
+    td.adj[0] = s->prev;
+    td.adj[1] = s->next;
+    ctx->internal->execute(ctx, deinterlace_slice, &td, NULL,
+                           FFMIN(s->planeheight[1], s->nb_threads));
 
-    return ff_filter_frame(outlink, out);
+    ret = ff_filter_frame(outlink, td.out[0]);
+    if (ret < 0) {
+        av_frame_free(&td.out[1]);
+        return ret;
+    }
+    return ff_filter_frame(outlink, td.out[1]);
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     W3FDIFContext *s = ctx->priv;
-    int ret;
 
     av_frame_free(&s->prev);
     s->prev = s->cur;
@@ -516,11 +525,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     if (!s->prev)
         return 0;
 
-    ret = filter(ctx, 0);
-    if (ret < 0)
-        return ret;
-
-    return filter(ctx, 1);
+    return filter(ctx);
 }
 
 static int request_frame(AVFilterLink *outlink)
@@ -32,10 +32,9 @@
 #include "yadif.h"
 
 typedef struct ThreadData {
-    AVFrame *frame;
-    int plane;
-    int w, h;
-    int parity;
+    AVFrame *frame[2];
+    int parity[2];
+    int nb_fields;
     int tff;
 } ThreadData;
 
@@ -188,15 +187,13 @@ static void filter_edges_16bit(void *dst1, void *prev1, void *cur1, void *next1,
     FILTER(w - 3, w, 0)
 }
 
-static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void filter_plane_slice(YADIFContext *s, AVFrame *frame, int plane,
+                               int w, int h, int parity, int tff,
+                               int slice_start, int slice_end)
 {
-    YADIFContext *s = ctx->priv;
-    ThreadData *td  = arg;
-    int refs = s->cur->linesize[td->plane];
-    int df = (s->csp->comp[td->plane].depth + 7) / 8;
+    int refs = s->cur->linesize[plane];
+    int df = (s->csp->comp[plane].depth + 7) / 8;
     int pix_3 = 3 * df;
-    int slice_start = (td->h *  jobnr   ) / nb_jobs;
-    int slice_end   = (td->h * (jobnr+1)) / nb_jobs;
     int y;
     int edge = 3 + MAX_ALIGN / df - 1;
 
@@ -204,60 +201,87 @@ static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
      * we need to call the c variant which avoids this for border pixels
      */
     for (y = slice_start; y < slice_end; y++) {
-        if ((y ^ td->parity) & 1) {
-            uint8_t *prev = &s->prev->data[td->plane][y * refs];
-            uint8_t *cur  = &s->cur ->data[td->plane][y * refs];
-            uint8_t *next = &s->next->data[td->plane][y * refs];
-            uint8_t *dst  = &td->frame->data[td->plane][y * td->frame->linesize[td->plane]];
-            int     mode  = y == 1 || y + 2 == td->h ? 2 : s->mode;
+        if ((y ^ parity) & 1) {
+            uint8_t *prev = &s->prev->data[plane][y * refs];
+            uint8_t *cur  = &s->cur ->data[plane][y * refs];
+            uint8_t *next = &s->next->data[plane][y * refs];
+            uint8_t *dst  = &frame->data[plane][y * frame->linesize[plane]];
+            int     mode  = y == 1 || y + 2 == h ? 2 : s->mode;
             s->filter_line(dst + pix_3, prev + pix_3, cur + pix_3,
-                           next + pix_3, td->w - edge,
-                           y + 1 < td->h ? refs : -refs,
+                           next + pix_3, w - edge,
+                           y + 1 < h ? refs : -refs,
                            y ? -refs : refs,
-                           td->parity ^ td->tff, mode);
-            s->filter_edges(dst, prev, cur, next, td->w,
-                            y + 1 < td->h ? refs : -refs,
+                           parity ^ tff, mode);
+            s->filter_edges(dst, prev, cur, next, w,
+                            y + 1 < h ? refs : -refs,
                             y ? -refs : refs,
-                            td->parity ^ td->tff, mode);
+                            parity ^ tff, mode);
         } else {
-            memcpy(&td->frame->data[td->plane][y * td->frame->linesize[td->plane]],
-                   &s->cur->data[td->plane][y * refs], td->w * df);
+            memcpy(&frame->data[plane][y * frame->linesize[plane]],
+                   &s->cur->data[plane][y * refs], w * df);
         }
     }
-    return 0;
 }
 
-static void filter(AVFilterContext *ctx, AVFrame *dstpic,
-                   int parity, int tff)
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    YADIFContext *yadif = ctx->priv;
-    ThreadData td = { .frame = dstpic, .parity = parity, .tff = tff };
-    int i;
+    YADIFContext *s = ctx->priv;
+    ThreadData *td  = arg;
+    int i, field;
 
-    for (i = 0; i < yadif->csp->nb_components; i++) {
-        int w = dstpic->width;
-        int h = dstpic->height;
+    for (i = 0; i < s->csp->nb_components; i++) {
+        int w = td->frame[0]->width;
+        int h = td->frame[0]->height;
 
         if (i == 1 || i == 2) {
-            w = AV_CEIL_RSHIFT(w, yadif->csp->log2_chroma_w);
-            h = AV_CEIL_RSHIFT(h, yadif->csp->log2_chroma_h);
+            w = AV_CEIL_RSHIFT(w, s->csp->log2_chroma_w);
+            h = AV_CEIL_RSHIFT(h, s->csp->log2_chroma_h);
         }
 
+        for (field = 0; field < td->nb_fields; field++)
+            filter_plane_slice(s, td->frame[field], i, w, h,
+                               td->parity[field], td->tff,
+                               (h *  jobnr   ) / nb_jobs,
+                               (h * (jobnr+1)) / nb_jobs);
+    }
+    emms_c();
+    return 0;
+}
 
-        td.w       = w;
-        td.h       = h;
-        td.plane   = i;
+/**
+ * Filter the planes of the current frame in a single pass of the slice
+ * threads, for dstpic and, if not NULL, for the frame of the second field.
+ */
+static void filter(AVFilterContext *ctx, AVFrame *dstpic, AVFrame *second,
+                   int parity, int tff)
+{
+    YADIFContext *yadif = ctx->priv;
+    ThreadData td = { .frame  = { dstpic, second },
+                      .parity = { parity, parity ^ 1 },
+                      .nb_fields = second ? 2 : 1,
+                      .tff = tff };
+    int h = AV_CEIL_RSHIFT(dstpic->height, yadif->csp->log2_chroma_h);
+
+    ctx->internal->execute(ctx, filter_slice, &td, NULL,
+                           FFMIN(h, ff_filter_get_nb_threads(ctx)));
+}
 
-        ctx->internal->execute(ctx, filter_slice, &td, NULL, FFMIN(h, ff_filter_get_nb_threads(ctx)));
-    }
+static AVFrame *get_field_buffer(AVFilterContext *ctx)
+{
+    YADIFContext *yadif = ctx->priv;
+    AVFilterLink *link  = ctx->outputs[0];
+    AVFrame *out = ff_get_video_buffer(link, link->w, link->h);
 
-    emms_c();
+    if (!out)
+        return NULL;
+    av_frame_copy_props(out, yadif->cur);
+    out->interlaced_frame = 0;
+    return out;
 }
 
 static int return_frame(AVFilterContext *ctx, int is_second)
 {
     YADIFContext *yadif = ctx->priv;
-    AVFilterLink *link  = ctx->outputs[0];
     int tff, ret;
 
     if (yadif->parity == -1) {
@@ -267,17 +291,25 @@ static int return_frame(AVFilterContext *ctx, int is_second)
         tff = yadif->parity ^ 1;
     }
 
-    if (is_second) {
-        yadif->out = ff_get_video_buffer(link, link->w, link->h);
+    if (is_second && yadif->second) {
+        yadif->out    = yadif->second;
+        yadif->second = NULL;
+    } else if (is_second) {
+        yadif->out = get_field_buffer(ctx);
         if (!yadif->out)
             return AVERROR(ENOMEM);
-
-        av_frame_copy_props(yadif->out, yadif->cur);
-        yadif->out->interlaced_frame = 0;
+        filter(ctx, yadif->out, NULL, tff, tff);
+    } else {
+        /* in field mode, the second field is filtered with the first one and
+         * output once the next frame is requested */
+        if (yadif->mode & 1) {
+            yadif->second = get_field_buffer(ctx);
+            if (!yadif->second)
+                return AVERROR(ENOMEM);
+        }
+        filter(ctx, yadif->out, yadif->second, tff ^ 1, tff);
     }
 
-    filter(ctx, yadif->out, tff ^ !is_second, tff);
-
     if (is_second) {
         int64_t cur_pts  = yadif->cur->pts;
         int64_t next_pts = yadif->next->pts;
@@ -421,6 +453,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&yadif->prev);
     av_frame_free(&yadif->cur );
     av_frame_free(&yadif->next);
+    av_frame_free(&yadif->second);
 }
 
 static int query_formats(AVFilterContext *ctx)
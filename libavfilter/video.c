@@ -41,9 +41,101 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
     return ff_get_video_buffer(link->dst->outputs[0], w, h);
 }
 
+/**
+ * Get the maximum number of pools kept by a graph: each video link carries
+ * frames of a single geometry at a time, so a graph never needs more pools
+ * than it has video links.
+ */
+static int graph_max_video_pools(AVFilterGraph *graph)
+{
+    int i, j, nb = 0;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        for (j = 0; j < graph->filters[i]->nb_outputs; j++) {
+            AVFilterLink *link = graph->filters[i]->outputs[j];
+            nb += link && link->type == AVMEDIA_TYPE_VIDEO;
+        }
+    return FFMAX(nb, 1);
+}
+
+/**
+ * Get the pool shared by all the links of the graph carrying frames with the
+ * given geometry, so that buffers released by a filter can be reused by any
+ * other filter of the graph instead of each link keeping its own set.
+ */
+static FFFramePool *graph_video_pool(AVFilterGraph *graph, int w, int h,
+                                     enum AVPixelFormat format)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    FFFramePool *pool, **pools;
+    int i, max_pools;
+
+    for (i = gi->nb_video_pools - 1; i >= 0; i--) {
+        int pool_width, pool_height, pool_align;
+        enum AVPixelFormat pool_format;
+
+        pool = gi->video_pools[i];
+        if (ff_frame_pool_get_video_config(pool, &pool_width, &pool_height,
+                                           &pool_format, &pool_align) < 0)
+            return NULL;
+
+        if (pool_width == w && pool_height == h &&
+            pool_format == format && pool_align == BUFFER_ALIGN) {
+            /* move it to the most recently used end */
+            memmove(gi->video_pools + i, gi->video_pools + i + 1,
+                    (gi->nb_video_pools - i - 1) * sizeof(*gi->video_pools));
+            gi->video_pools[gi->nb_video_pools - 1] = pool;
+            return pool;
+        }
+    }
+
+    max_pools = graph_max_video_pools(graph);
+    while (gi->nb_video_pools >= max_pools) {
+        /* drop the least recently used pool, the frames still in use keep
+         * it alive */
+        ff_frame_pool_uninit(&gi->video_pools[0]);
+        memmove(gi->video_pools, gi->video_pools + 1,
+                (gi->nb_video_pools - 1) * sizeof(*gi->video_pools));
+        gi->nb_video_pools--;
+    }
+
+    pools = av_realloc_array(gi->video_pools, gi->nb_video_pools + 1,
+                             sizeof(*gi->video_pools));
+    if (!pools)
+        return NULL;
+    gi->video_pools = pools;
+
+    pool = ff_frame_pool_video_init(av_buffer_allocz, w, h, format, BUFFER_ALIGN);
+    if (!pool)
+        return NULL;
+    gi->video_pools[gi->nb_video_pools++] = pool;
+
+    return pool;
+}
+
+static AVFrame *graph_get_video_buffer(AVFilterGraph *graph, int w, int h,
+                                       enum AVPixelFormat format)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    /* the pools are shared with the filters running concurrently */
+    int locked = gi->sched_busy;
+    AVFrame *frame = NULL;
+    FFFramePool *pool;
+
+    if (locked)
+        ff_mutex_lock(&gi->sched_lock);
+    pool = graph_video_pool(graph, w, h, format);
+    if (pool)
+        frame = ff_frame_pool_get(pool);
+    if (locked)
+        ff_mutex_unlock(&gi->sched_lock);
+    return frame;
+}
+
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
     AVFrame *frame = NULL;
+    FFFramePool *pool;
     int pool_width = 0;
     int pool_height = 0;
     int pool_align = 0;
@@ -64,11 +156,17 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
         return frame;
     }
 
-    if (!link->frame_pool) {
+    if (link->graph) {
+        frame = graph_get_video_buffer(link->graph, w, h, link->format);
+        if (frame)
+            frame->sample_aspect_ratio = link->sample_aspect_ratio;
+        return frame;
+    } else if (!link->frame_pool) {
         link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
                                                     link->format, BUFFER_ALIGN);
         if (!link->frame_pool)
             return NULL;
+        pool = link->frame_pool;
     } else {
         if (ff_frame_pool_get_video_config(link->frame_pool,
                                            &pool_width, &pool_height,
@@ -85,9 +183,10 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
             if (!link->frame_pool)
                 return NULL;
         }
+        pool = link->frame_pool;
     }
 
-    frame = ff_frame_pool_get(link->frame_pool);
+    frame = ff_frame_pool_get(pool);
     if (!frame)
         return NULL;
 
@@ -53,6 +53,7 @@ typedef struct YADIFContext {
     AVFrame *next;
     AVFrame *prev;
     AVFrame *out;
+    AVFrame *second;    ///< second field of the current frame, already filtered
 
     /**
      * Required alignment for filter_line
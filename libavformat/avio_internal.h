@@ -83,6 +83,14 @@ uint64_t ffio_read_varlen(AVIOContext *bc);
  */
 int ffio_read_size(AVIOContext *s, unsigned char *buf, int size);
 
+/**
+ * Skip the bytes before the next occurrence of a byte value, looking for it
+ * in at most max_size bytes. Once found, the byte is the next one read.
+ * @return number of bytes skipped, max_size if the byte was not found, or
+ *         AVERROR_EOF
+ */
+int ffio_skip_to_byte(AVIOContext *s, int b, int max_size);
+
 /** @warning must be called before any I/O */
 int ffio_set_buf_size(AVIOContext *s, int buf_size);
 
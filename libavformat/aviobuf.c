@@ -645,6 +645,32 @@ int avio_r8(AVIOContext *s)
     return 0;
 }
 
+int ffio_skip_to_byte(AVIOContext *s, int b, int max_size)
+{
+    int skipped = 0;
+
+    while (skipped < max_size) {
+        int len = FFMIN(s->buf_end - s->buf_ptr, max_size - skipped);
+        uint8_t *found;
+
+        if (len <= 0) {
+            fill_buffer(s);
+            if (s->buf_ptr >= s->buf_end)
+                return AVERROR_EOF;
+            continue;
+        }
+        found = memchr(s->buf_ptr, b, len);
+        if (found) {
+            skipped   += found - s->buf_ptr;
+            s->buf_ptr = found;
+            return skipped;
+        }
+        s->buf_ptr += len;
+        skipped    += len;
+    }
+    return skipped;
+}
+
 int avio_read(AVIOContext *s, unsigned char *buf, int size)
 {
     int len, size1;
@@ -686,6 +686,85 @@ end:
     return 0;
 }
 
+static int write_hls_master_playlist(AVFormatContext *s, int use_rename)
+{
+    DASHContext *c = s->priv_data;
+    AVIOContext *out = NULL;
+    AVDictionary *opts = NULL;
+    char filename_hls[1024], temp_filename[1024];
+    const char *audio_group = "A1";
+    const char *audio_codec = NULL;
+    int is_default = 1;
+    int max_audio_bitrate = 0;
+    int complete = 1;
+    int ret, i;
+
+    if (*c->dirname)
+        snprintf(filename_hls, sizeof(filename_hls), "%s/master.m3u8", c->dirname);
+    else
+        snprintf(filename_hls, sizeof(filename_hls), "master.m3u8");
+
+    snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", filename_hls);
+
+    set_http_options(&opts, c);
+    ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
+        return ret;
+    }
+
+    ff_hls_write_playlist_version(out, 6);
+
+    /* the bit rates measured on the first segments are used if none is set */
+    for (i = 0; i < s->nb_streams; i++) {
+        char playlist_file[64];
+        OutputStream *os = &c->streams[i];
+        AVStream *st = s->streams[i];
+        if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+            continue;
+        get_hls_playlist_name(playlist_file, sizeof(playlist_file), NULL, i);
+        ff_hls_write_audio_rendition(out, (char *)audio_group,
+                                     playlist_file, i, is_default);
+        if (!audio_codec || os->bit_rate > max_audio_bitrate)
+            audio_codec = os->codec_str;
+        max_audio_bitrate = FFMAX(os->bit_rate, max_audio_bitrate);
+        is_default = 0;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        char playlist_file[64];
+        char codec_str[sizeof(c->streams[i].codec_str) * 2];
+        OutputStream *os = &c->streams[i];
+        AVStream *st = s->streams[i];
+        char *agroup = NULL;
+        int stream_bitrate = os->bit_rate;
+
+        av_strlcpy(codec_str, os->codec_str, sizeof(codec_str));
+        if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) && max_audio_bitrate) {
+            agroup = (char *)audio_group;
+            stream_bitrate += max_audio_bitrate;
+            if (codec_str[0] && audio_codec[0])
+                av_strlcatf(codec_str, sizeof(codec_str), ",%s", audio_codec);
+        }
+        if (!os->bit_rate) {
+            complete = 0;
+            continue;
+        }
+        get_hls_playlist_name(playlist_file, sizeof(playlist_file), NULL, i);
+        ff_hls_write_stream_info(st, out, stream_bitrate, playlist_file, agroup,
+                                 codec_str, NULL);
+    }
+    avio_close(out);
+    if (use_rename)
+        if ((ret = avpriv_io_move(temp_filename, filename_hls)) < 0)
+            return ret;
+    /* written again once the bit rates of all the streams are known */
+    c->master_playlist_created = complete;
+
+    return 0;
+}
+
 static int write_manifest(AVFormatContext *s, int final)
 {
     DASHContext *c = s->priv_data;
@@ -783,57 +862,8 @@ static int write_manifest(AVFormatContext *s, int final)
     }
 
     if (c->hls_playlist && !c->master_playlist_created) {
-        char filename_hls[1024];
-        const char *audio_group = "A1";
-        int is_default = 1;
-        int max_audio_bitrate = 0;
-
-        if (*c->dirname)
-            snprintf(filename_hls, sizeof(filename_hls), "%s/master.m3u8", c->dirname);
-        else
-            snprintf(filename_hls, sizeof(filename_hls), "master.m3u8");
-
-        snprintf(temp_filename, sizeof(temp_filename), use_rename ? "%s.tmp" : "%s", filename_hls);
-
-        set_http_options(&opts, c);
-        ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE, NULL, &opts);
-        if (ret < 0) {
-            av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
+        if ((ret = write_hls_master_playlist(s, use_rename)) < 0)
             return ret;
-        }
-        av_dict_free(&opts);
-
-        ff_hls_write_playlist_version(out, 6);
-
-        for (i = 0; i < s->nb_streams; i++) {
-            char playlist_file[64];
-            AVStream *st = s->streams[i];
-            if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
-                continue;
-            get_hls_playlist_name(playlist_file, sizeof(playlist_file), NULL, i);
-            ff_hls_write_audio_rendition(out, (char *)audio_group,
-                                         playlist_file, i, is_default);
-            max_audio_bitrate = FFMAX(st->codecpar->bit_rate, max_audio_bitrate);
-            is_default = 0;
-        }
-
-        for (i = 0; i < s->nb_streams; i++) {
-            char playlist_file[64];
-            AVStream *st = s->streams[i];
-            char *agroup = NULL;
-            int stream_bitrate = st->codecpar->bit_rate;
-            if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) && max_audio_bitrate) {
-                agroup = (char *)audio_group;
-                stream_bitrate += max_audio_bitrate;
-            }
-            get_hls_playlist_name(playlist_file, sizeof(playlist_file), NULL, i);
-            ff_hls_write_stream_info(st, out, stream_bitrate, playlist_file, agroup, NULL, NULL);
-        }
-        avio_close(out);
-        if (use_rename)
-            if ((ret = avpriv_io_move(temp_filename, filename_hls)) < 0)
-                return ret;
-        c->master_playlist_created = 1;
     }
 
     return 0;
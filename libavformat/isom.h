@@ -213,6 +213,25 @@ typedef struct MOVStreamContext {
     uint32_t format;
 
     int has_sidx;  // If there is an sidx entry for this stream.
+    int has_frag_dts; ///< the fragment index has the tfdt of its fragments
+
+    /**
+     * Lazy index: the sample tables are kept and the current sample is
+     * located from them, instead of building st->index_entries.
+     */
+    int lazy_index;
+    AVIndexEntry lazy_entry;            ///< current sample
+    unsigned int *lazy_stts_first;      ///< first sample of each stts entry
+    int64_t *lazy_stts_first_dts;       ///< dts of the first sample of each stts entry
+    unsigned int *lazy_stsc_first;      ///< first sample of each stsc entry
+    unsigned int lazy_stts_index;
+    unsigned int lazy_stts_sample;
+    unsigned int lazy_stsc_index;
+    unsigned int lazy_chunk;
+    unsigned int lazy_chunk_sample;
+    unsigned int lazy_stss_index;
+    int lazy_key_off;
+    int lazy_all_keyframes;
     struct {
         int use_subsamples;
         uint8_t* auxiliary_info;
@@ -252,6 +271,7 @@ typedef struct MOVContext {
     int advanced_editlist;
     int ignore_chapters;
     int seek_individually;
+    int lazy_index;
     int64_t next_root_atom; ///< offset of the next root atom
     int export_all;
     int export_xmp;
@@ -260,6 +280,8 @@ typedef struct MOVContext {
     int moov_retry;
     int use_mfra_for;
     int has_looked_for_mfra;
+    int lazy_fragments;
+    int has_scanned_fragments;
     MOVFragmentIndex frag_index;
     int atom_depth;
     unsigned int aax_mode;  ///< 'aax' file has been detected
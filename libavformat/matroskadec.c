@@ -306,6 +306,18 @@ typedef struct MatroskaCluster {
     EbmlList blocks;
 } MatroskaCluster;
 
+/* size under which seeking without index parses the clusters linearly */
+#define MATROSKA_BISECT_MIN_SIZE (1 << 20)
+/* maximum distance between two clusters looked for when bisecting, a bit
+ * more than the largest clusters written by the muxer */
+#define MATROSKA_BISECT_SCAN_SIZE (8 << 20)
+
+/* byte range whose clusters were skipped by the bisection and not indexed */
+typedef struct MatroskaIndexGap {
+    int64_t start;
+    int64_t end;
+} MatroskaIndexGap;
+
 typedef struct MatroskaLevel1Element {
     uint64_t id;
     uint64_t pos;
@@ -351,6 +363,10 @@ typedef struct MatroskaDemuxContext {
     /* File has a CUES element, but we defer parsing until it is needed. */
     int cues_parsing_deferred;
 
+    /* Clusters between index entries skipped when seeking. */
+    MatroskaIndexGap *index_gaps;
+    int nb_index_gaps;
+
     /* Level1 elements and whether they were read yet */
     MatroskaLevel1Element level1_elems[64];
     int num_level1_elems;
@@ -1213,6 +1229,19 @@ static int ebml_parse_elem(MatroskaDemuxContext *matroska,
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
+        if (id == MATROSKA_ID_CUES && matroska->cues_parsing_deferred > 0 &&
+            length != 0xffffffffffffffULL &&
+            (pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+            (level1_elem = matroska_find_level1_elem(matroska, id)) &&
+            !level1_elem->parsed) {
+            /* Cues placed before the clusters are parsed on the first seek
+             * too, only remember where they are (res is the size of the
+             * length, the ID takes 4 bytes). */
+            level1_elem->pos = avio_tell(pb) - res - 4 - matroska->segment_start;
+            if (ffio_limit(pb, length) != length)
+                return AVERROR(EIO);
+            return avio_skip(pb, length) < 0 ? AVERROR(EIO) : 0;
+        }
         if ((res = ebml_read_master(matroska, length)) < 0)
             return res;
         if (id == MATROSKA_ID_SEGMENT)
@@ -1686,6 +1715,9 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     if (matroska->ctx->flags & AVFMT_FLAG_IGNIDX)
         return;
 
+    if (matroska->cues_parsing_deferred > 0)
+        matroska->cues_parsing_deferred = 0;
+
     for (i = 0; i < matroska->num_level1_elems; i++) {
         MatroskaLevel1Element *elem = &matroska->level1_elems[i];
         if (elem->id == MATROSKA_ID_CUES && !elem->parsed) {
@@ -3515,12 +3547,237 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
+/*
+ * Read the timecode of a cluster, which must be its first element after
+ * any CRC-32 or Void elements, from the position following the cluster ID.
+ * Return: 0 on success, < 0 if this does not look like a cluster.
+ */
+static int matroska_read_cluster_timecode(MatroskaDemuxContext *matroska,
+                                          int64_t end, uint64_t *timecode)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    uint64_t length, id;
+    int i, res;
+
+    if (ebml_read_length(matroska, pb, &length) <= 0)
+        return AVERROR_INVALIDDATA;
+    for (i = 0; i < 3; i++) {
+        if ((res = ebml_read_num(matroska, pb, 4, &id)) <= 0 ||
+            ebml_read_length(matroska, pb, &length) <= 0)
+            return AVERROR_INVALIDDATA;
+        id |= 1ULL << 7 * res;
+        if (id == MATROSKA_ID_CLUSTERTIMECODE)
+            return length > 8 ? AVERROR_INVALIDDATA :
+                                ebml_read_uint(pb, length, timecode);
+        if ((id != EBML_ID_CRC32 && id != EBML_ID_VOID) ||
+            length > end - avio_tell(pb))
+            break;
+        avio_skip(pb, length);
+    }
+    return AVERROR_INVALIDDATA;
+}
+
+/*
+ * Find the first cluster starting between pos and end, and read its
+ * timecode.
+ * Return: 0 on success, < 0 if no such cluster was found.
+ */
+static int matroska_find_cluster(MatroskaDemuxContext *matroska,
+                                 int64_t pos, int64_t end,
+                                 int64_t *cluster_pos, uint64_t *timecode)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    uint32_t tag;
+
+    if (avio_seek(pb, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+
+    tag = avio_rb32(pb);
+    while (!avio_feof(pb) && avio_tell(pb) - 4 < end) {
+        if (tag == MATROSKA_ID_CLUSTER) {
+            int64_t start = avio_tell(pb) - 4;
+            if (!matroska_read_cluster_timecode(matroska, end, timecode)) {
+                *cluster_pos = start;
+                return 0;
+            }
+            if (avio_seek(pb, start + 4, SEEK_SET) < 0)
+                return AVERROR(EIO);
+        }
+        tag = (tag << 8) | avio_r8(pb);
+    }
+
+    return AVERROR_EOF;
+}
+
+/*
+ * Find by bisection on the cluster timecodes the position of a cluster
+ * starting at or before timestamp, between pos which is such a position
+ * and pos_max. This avoids parsing all the clusters from pos when seeking
+ * beyond the index, in files without Cues.
+ */
+static int64_t matroska_bisect_clusters(MatroskaDemuxContext *matroska,
+                                        int64_t pos, int64_t pos_max,
+                                        int64_t timestamp)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t size, cluster_pos;
+    uint64_t timecode;
+
+    if (!(pb->seekable & AVIO_SEEKABLE_NORMAL) ||
+        (size = avio_size(pb)) <= 0)
+        return pos;
+    pos_max = FFMIN(pos_max, size);
+
+    while (pos_max - pos > MATROSKA_BISECT_MIN_SIZE) {
+        int64_t mid = pos + (pos_max - pos) / 2;
+        if (matroska_find_cluster(matroska, mid,
+                                  FFMIN(pos_max, mid + MATROSKA_BISECT_SCAN_SIZE),
+                                  &cluster_pos, &timecode) < 0 ||
+            (int64_t)timecode > timestamp)
+            pos_max = mid;
+        else
+            pos = cluster_pos;
+    }
+
+    return pos;
+}
+
+/*
+ * Index the clusters before pos, down to pos_min, until the key frame to
+ * seek to for timestamp is found. It is usually in the clusters skipped by
+ * the bisection, just before pos. Returns the position of the first
+ * cluster indexed.
+ */
+static int64_t matroska_index_backwards(MatroskaDemuxContext *matroska, AVStream *st,
+                                        int64_t pos_min, int64_t pos,
+                                        int64_t timestamp, int flags)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t step = MATROSKA_BISECT_MIN_SIZE;
+    int64_t cluster_pos;
+    uint64_t timecode;
+    int index;
+
+    while (pos > pos_min) {
+        index = av_index_search_timestamp(st, timestamp, flags);
+        if (index >= 0 && st->index_entries[index].pos >= pos)
+            break;
+
+        if (matroska_find_cluster(matroska, FFMAX(pos - step, pos_min), pos,
+                                  &cluster_pos, &timecode) < 0) {
+            if (pos - step > pos_min) {
+                step *= 2;
+                continue;
+            }
+            cluster_pos = pos_min;
+        }
+
+        avio_seek(pb, cluster_pos, SEEK_SET);
+        matroska->current_id = 0;
+        while (avio_tell(pb) < pos) {
+            matroska_clear_queue(matroska);
+            if (matroska_parse_cluster(matroska) < 0)
+                break;
+        }
+        pos   = cluster_pos;
+        step *= 2;
+    }
+
+    return pos;
+}
+
+static void matroska_add_index_gap(MatroskaDemuxContext *matroska,
+                                   int64_t start, int64_t end)
+{
+    if (start >= end)
+        return;
+    if (av_reallocp_array(&matroska->index_gaps, matroska->nb_index_gaps + 1,
+                          sizeof(*matroska->index_gaps)) < 0) {
+        matroska->nb_index_gaps = 0;
+        return;
+    }
+    matroska->index_gaps[matroska->nb_index_gaps].start = start;
+    matroska->index_gaps[matroska->nb_index_gaps].end   = end;
+    matroska->nb_index_gaps++;
+}
+
+/*
+ * Find the byte range whose clusters may hold the key frames around
+ * timestamp but are not indexed: a gap left between the index entries
+ * around it by a previous seek, or the clusters after the last entry.
+ * The gap returned is forgotten, as the caller indexes it.
+ */
+static int matroska_find_index_gap(MatroskaDemuxContext *matroska, AVStream *st,
+                                   int64_t timestamp,
+                                   int64_t *pos_min, int64_t *pos_max)
+{
+    int before = av_index_search_timestamp(st, timestamp, AVSEEK_FLAG_BACKWARD);
+    int after  = av_index_search_timestamp(st, timestamp, 0);
+    int64_t before_pos = st->index_entries[FFMAX(before, 0)].pos;
+    int64_t after_pos  = after >= 0 ? st->index_entries[after].pos : INT64_MAX;
+    int i;
+
+    for (i = 0; i < matroska->nb_index_gaps; i++) {
+        MatroskaIndexGap *gap = &matroska->index_gaps[i];
+        if (gap->start < after_pos && gap->end > before_pos) {
+            *pos_min = gap->start;
+            *pos_max = gap->end;
+            memmove(gap, gap + 1,
+                    (matroska->nb_index_gaps - i - 1) * sizeof(*gap));
+            matroska->nb_index_gaps--;
+            return 0;
+        }
+    }
+
+    if (after >= 0)
+        return -1;
+    *pos_min = st->index_entries[st->nb_index_entries - 1].pos;
+    *pos_max = INT64_MAX;
+    return 0;
+}
+
+/*
+ * Index the clusters between pos_min and pos_max around timestamp: those
+ * from a cluster found by bisection until a key frame at or after
+ * timestamp, then backwards until the key frame to seek to. The clusters
+ * left out are remembered as gaps, so that later seeks into them do not
+ * miss their key frames.
+ */
+static void matroska_index_range(MatroskaDemuxContext *matroska, AVStream *st,
+                                 int64_t pos_min, int64_t pos_max,
+                                 int64_t timestamp, int flags)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t pos = matroska_bisect_clusters(matroska, pos_min, pos_max, timestamp);
+    int64_t end;
+    int index;
+
+    avio_seek(pb, pos, SEEK_SET);
+    matroska->current_id = 0;
+    while (avio_tell(pb) < pos_max) {
+        index = av_index_search_timestamp(st, timestamp, 0);
+        if (index >= 0 && st->index_entries[index].pos >= pos &&
+            st->index_entries[index].pos < avio_tell(pb))
+            break;
+        matroska_clear_queue(matroska);
+        if (matroska_parse_cluster(matroska) < 0)
+            break;
+    }
+    end = avio_tell(pb);
+
+    pos = matroska_index_backwards(matroska, st, pos_min, pos, timestamp, flags);
+    matroska_add_index_gap(matroska, pos_min, pos);
+    if (pos_max != INT64_MAX)
+        matroska_add_index_gap(matroska, end, pos_max);
+}
+
 static int matroska_read_seek(AVFormatContext *s, int stream_index,
                               int64_t timestamp, int flags)
 {
     MatroskaDemuxContext *matroska = s->priv_data;
     MatroskaTrack *tracks = NULL;
     AVStream *st = s->streams[stream_index];
+    int64_t pos_min, pos_max;
     int i, index, index_min;
 
     /* Parse the CUES now since we need the index data to seek. */
@@ -3533,16 +3790,9 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         goto err;
     timestamp = FFMAX(timestamp, st->index_entries[0].timestamp);
 
-    if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 || index == st->nb_index_entries - 1) {
-        avio_seek(s->pb, st->index_entries[st->nb_index_entries - 1].pos,
-                  SEEK_SET);
-        matroska->current_id = 0;
-        while ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 || index == st->nb_index_entries - 1) {
-            matroska_clear_queue(matroska);
-            if (matroska_parse_cluster(matroska) < 0)
-                break;
-        }
-    }
+    if (!matroska_find_index_gap(matroska, st, timestamp, &pos_min, &pos_max))
+        matroska_index_range(matroska, st, pos_min, pos_max, timestamp, flags);
+    index = av_index_search_timestamp(st, timestamp, flags);
 
     matroska_clear_queue(matroska);
     if (index < 0 || (matroska->cues_parsing_deferred < 0 && index == st->nb_index_entries - 1))
@@ -3596,6 +3846,7 @@ static int matroska_read_close(AVFormatContext *s)
             av_freep(&tracks[n].audio.buf);
     ebml_free(matroska_cluster, &matroska->current_cluster);
     ebml_free(matroska_segment, matroska);
+    av_freep(&matroska->index_gaps);
 
     return 0;
 }
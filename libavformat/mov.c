@@ -1248,7 +1248,7 @@ static int64_t get_frag_time(MOVFragmentIndex *frag_index,
 
     if (track_id >= 0) {
         frag_stream_info = get_frag_stream_info(frag_index, index, track_id);
-        return frag_stream_info->sidx_pts;
+        return get_stream_info_time(frag_stream_info);
     }
 
     for (i = 0; i < frag_index->item[index].nb_stream_info; i++) {
@@ -1263,15 +1263,15 @@ static int64_t get_frag_time(MOVFragmentIndex *frag_index,
 static int search_frag_timestamp(MOVFragmentIndex *frag_index,
                                  AVStream *st, int64_t timestamp)
 {
-    int a, b, m;
+    int a, b, m, m0;
     int64_t frag_time;
     int id = -1;
 
     if (st) {
-        // If the stream is referenced by any sidx, limit the search
-        // to fragments that referenced this stream in the sidx
+        // If the stream is referenced by any sidx or its fragments were
+        // scanned, limit the search to fragments that have a time for it
         MOVStreamContext *sc = st->priv_data;
-        if (sc->has_sidx)
+        if (sc->has_sidx || sc->has_frag_dts)
             id = st->id;
     }
 
@@ -1279,14 +1279,19 @@ static int search_frag_timestamp(MOVFragmentIndex *frag_index,
     b = frag_index->nb_items;
 
     while (b - a > 1) {
-        m = (a + b) >> 1;
-        frag_time = get_frag_time(frag_index, m, id);
-        if (frag_time != AV_NOPTS_VALUE) {
-            if (frag_time >= timestamp)
-                b = m;
-            if (frag_time <= timestamp)
-                a = m;
+        m0 = m = (a + b) >> 1;
+        // Search for the next fragment with a time
+        while (m < b &&
+               (frag_time = get_frag_time(frag_index, m, id)) == AV_NOPTS_VALUE)
+            m++;
+        if (m == b) {
+            b = m0;
+            continue;
         }
+        if (frag_time >= timestamp)
+            b = m;
+        if (frag_time <= timestamp)
+            a = m;
     }
     return a;
 }
@@ -1356,6 +1361,192 @@ static void fix_frag_index_entries(MOVFragmentIndex *frag_index, int index,
     }
 }
 
+/**
+ * Read the header of the box at the current position, which must end
+ * before end.
+ *
+ * @return the size of the box header, or a negative value if it is invalid
+ */
+static int mov_scan_box_header(AVIOContext *pb, int64_t end,
+                               uint32_t *type, int64_t *size)
+{
+    int64_t pos = avio_tell(pb);
+    int header_size = 8;
+
+    if (pos + 8 > end)
+        return AVERROR_INVALIDDATA;
+    *size = avio_rb32(pb);
+    *type = avio_rl32(pb);
+    if (*size == 1) {
+        header_size = 16;
+        *size = avio_rb64(pb);
+    } else if (!*size) {
+        *size = end - pos;
+    }
+    if (avio_feof(pb) || *size < header_size || *size > end - pos)
+        return AVERROR_INVALIDDATA;
+    return header_size;
+}
+
+/**
+ * Read the track id and the tfdt of a traf box. For the last fragment, also
+ * sum the duration of its samples to set the duration of the stream.
+ */
+static int mov_scan_traf(MOVContext *c, AVIOContext *pb, int index,
+                         int64_t end, int last)
+{
+    MOVFragmentStreamInfo *frag_stream_info;
+    int64_t size, dts = AV_NOPTS_VALUE, duration = 0;
+    int64_t track_id = -1;
+    unsigned flags, entries, default_duration = 0, i;
+    uint32_t type;
+    int ret;
+
+    while (avio_tell(pb) < end) {
+        int64_t pos = avio_tell(pb);
+
+        if ((ret = mov_scan_box_header(pb, end, &type, &size)) < 0)
+            return ret;
+        if (type == MKTAG('t','f','h','d') && size >= ret + 8) {
+            flags    = avio_rb32(pb) & 0xffffff;
+            track_id = avio_rb32(pb);
+            for (i = 0; i < c->trex_count; i++)
+                if (c->trex_data[i].track_id == track_id)
+                    default_duration = c->trex_data[i].duration;
+            if (flags & MOV_TFHD_BASE_DATA_OFFSET)
+                avio_rb64(pb);
+            if (flags & MOV_TFHD_STSD_ID)
+                avio_rb32(pb);
+            if (flags & MOV_TFHD_DEFAULT_DURATION)
+                default_duration = avio_rb32(pb);
+        } else if (type == MKTAG('t','f','d','t') && size >= ret + 8) {
+            int version = avio_r8(pb);
+            avio_rb24(pb); /* flags */
+            dts = version ? avio_rb64(pb) : avio_rb32(pb);
+        } else if (type == MKTAG('t','r','u','n') && last && size >= ret + 8) {
+            int skip;
+
+            flags   = avio_rb32(pb) & 0xffffff;
+            entries = avio_rb32(pb);
+            if (flags & MOV_TRUN_DATA_OFFSET)
+                avio_rb32(pb);
+            if (flags & MOV_TRUN_FIRST_SAMPLE_FLAGS)
+                avio_rb32(pb);
+            skip = 4 * (!!(flags & MOV_TRUN_SAMPLE_SIZE) +
+                        !!(flags & MOV_TRUN_SAMPLE_FLAGS) +
+                        !!(flags & MOV_TRUN_SAMPLE_CTS));
+            if (!(flags & MOV_TRUN_SAMPLE_DURATION))
+                duration += (int64_t)entries * default_duration;
+            else
+                for (i = 0; i < entries && avio_tell(pb) + 4 <= pos + size; i++) {
+                    duration += avio_rb32(pb);
+                    avio_skip(pb, skip);
+                }
+        }
+        if (avio_seek(pb, pos + size, SEEK_SET) < 0)
+            return AVERROR_INVALIDDATA;
+    }
+
+    frag_stream_info = get_frag_stream_info(&c->frag_index, index, track_id);
+    if (frag_stream_info && dts != AV_NOPTS_VALUE)
+        frag_stream_info->tfdt_dts = dts;
+
+    if (last && dts != AV_NOPTS_VALUE) {
+        for (i = 0; i < c->fc->nb_streams; i++) {
+            AVStream *st = c->fc->streams[i];
+            MOVStreamContext *sc = st->priv_data;
+            if (st->id == track_id) {
+                sc->track_end = dts + duration;
+                if (st->duration < sc->track_end)
+                    st->duration = sc->track_end;
+            }
+        }
+    }
+    return 0;
+}
+
+static int mov_scan_moof(MOVContext *c, AVIOContext *pb, int64_t pos,
+                         int64_t end, int last)
+{
+    int index = update_frag_index(c, pos);
+    int64_t size;
+    uint32_t type;
+    int ret;
+
+    if (index < 0)
+        return AVERROR(ENOMEM);
+    while (avio_tell(pb) < end) {
+        pos = avio_tell(pb);
+        if ((ret = mov_scan_box_header(pb, end, &type, &size)) < 0)
+            return ret;
+        if (type == MKTAG('t','r','a','f') &&
+            (ret = mov_scan_traf(c, pb, index, pos + size, last)) < 0)
+            return ret;
+        if (avio_seek(pb, pos + size, SEEK_SET) < 0)
+            return AVERROR_INVALIDDATA;
+    }
+    return 0;
+}
+
+/**
+ * Add the fragments from the current moof to the end of the file to the
+ * fragment index, reading only the box headers and the tfhd and tfdt boxes,
+ * so that the trun boxes are parsed only for the fragments which are read.
+ */
+static void mov_scan_fragments(MOVContext *c, AVIOContext *pb)
+{
+    int64_t original_pos = avio_tell(pb);
+    int64_t pos = original_pos - 8, file_size = avio_size(pb), size;
+    int64_t last_pos = -1, last_size = 0;
+    uint32_t type;
+    int i, j, ret = 0;
+
+    av_log(c->fc, AV_LOG_VERBOSE, "scanning the fragments\n");
+    while (pos < file_size) {
+        if (avio_seek(pb, pos, SEEK_SET) != pos ||
+            (ret = mov_scan_box_header(pb, file_size, &type, &size)) < 0)
+            break;
+        if (type == MKTAG('m','o','o','f')) {
+            if ((ret = mov_scan_moof(c, pb, pos, pos + size, 0)) < 0)
+                break;
+            last_pos  = pos;
+            last_size = size;
+        }
+        pos += size;
+    }
+    if (ret >= 0 && last_pos >= 0 && avio_seek(pb, last_pos + 8, SEEK_SET) >= 0)
+        ret = mov_scan_moof(c, pb, last_pos, last_pos + last_size, 1);
+
+    if (ret >= 0) {
+        for (i = 0; i < c->frag_index.nb_items; i++)
+            if (get_frag_time(&c->frag_index, i, -1) == AV_NOPTS_VALUE)
+                break;
+        if (i == c->frag_index.nb_items) {
+            for (i = 0; i < c->fc->nb_streams; i++) {
+                MOVStreamContext *sc = c->fc->streams[i]->priv_data;
+                for (j = 0; j < c->frag_index.nb_items && !sc->has_frag_dts; j++) {
+                    MOVFragmentStreamInfo *frag_stream_info =
+                        get_frag_stream_info(&c->frag_index, j, c->fc->streams[i]->id);
+                    sc->has_frag_dts = frag_stream_info &&
+                                       frag_stream_info->tfdt_dts != AV_NOPTS_VALUE;
+                }
+            }
+            c->frag_index.complete = 1;
+            /* mov_read_default() stops parsing at any depth once the moov,
+             * an mdat and a complete fragment index are found. An mdat read
+             * before this moof, e.g. the one of the samples in the moov when
+             * the file was not written with empty_moov, would then stop the
+             * parsing of this moof after its first child. Forget it so that
+             * this moof is parsed and the header ends after its mdat. */
+            c->found_mdat = 0;
+        }
+    }
+    av_log(c->fc, AV_LOG_VERBOSE, "%d fragments indexed%s\n", c->frag_index.nb_items,
+           c->frag_index.complete ? "" : ", index incomplete");
+
+    avio_seek(pb, original_pos, SEEK_SET);
+}
+
 static int mov_read_moof(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
     if (!c->has_looked_for_mfra && c->use_mfra_for > 0) {
@@ -1373,6 +1564,12 @@ static int mov_read_moof(MOVContext *c, AVIOContext *pb, MOVAtom atom)
                     "seekable, can not look for mfra\n");
         }
     }
+    if (c->lazy_fragments && !c->has_scanned_fragments && c->found_moov &&
+        !c->frag_index.complete && (pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+        !(c->fc->flags & AVFMT_FLAG_IGNIDX)) {
+        c->has_scanned_fragments = 1;
+        mov_scan_fragments(c, pb);
+    }
     c->fragment.moof_offset = c->fragment.implicit_offset = avio_tell(pb) - 8;
     av_log(c->fc, AV_LOG_TRACE, "moof offset %"PRIx64"\n", c->fragment.moof_offset);
     c->frag_index.current = update_frag_index(c, c->fragment.moof_offset);
@@ -3251,6 +3448,180 @@ static int64_t add_ctts_entry(MOVStts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
+static unsigned int mov_lazy_sample_size(MOVStreamContext *sc, unsigned int sample)
+{
+    return sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[sample];
+}
+
+/* find the last entry of a sorted table of first samples that is <= sample */
+static unsigned int mov_lazy_search_first(const unsigned int *first, unsigned int count,
+                                          unsigned int sample)
+{
+    unsigned int a = 0, b = count;
+
+    while (b - a > 1) {
+        unsigned int m = (a + b) >> 1;
+        if (first[m] <= sample)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static int64_t mov_lazy_sample_dts(MOVStreamContext *sc, unsigned int sample)
+{
+    unsigned int i = mov_lazy_search_first(sc->lazy_stts_first, sc->stts_count, sample);
+
+    return sc->lazy_stts_first_dts[i] +
+           (int64_t)(sample - sc->lazy_stts_first[i]) * sc->stts_data[i].duration;
+}
+
+static void mov_lazy_update_entry(MOVStreamContext *sc, int64_t pos, int64_t dts)
+{
+    unsigned int sample = sc->current_sample;
+    int keyframe = sc->lazy_all_keyframes || (sc->keyframe_absent && !sample) ||
+                   (sc->lazy_stss_index < sc->keyframe_count &&
+                    sc->keyframes[sc->lazy_stss_index] == sample + sc->lazy_key_off);
+
+    sc->lazy_entry.pos          = pos;
+    sc->lazy_entry.timestamp    = dts;
+    sc->lazy_entry.size         = mov_lazy_sample_size(sc, sample);
+    sc->lazy_entry.min_distance = 0;
+    sc->lazy_entry.flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+}
+
+/* locate the current sample from the sample tables */
+static void mov_lazy_set_sample(MOVStreamContext *sc)
+{
+    unsigned int sample = sc->current_sample;
+    unsigned int i, n, a, b;
+    int64_t pos;
+
+    if (sc->current_sample < 0 || sample >= sc->sample_count)
+        return;
+
+    i = mov_lazy_search_first(sc->lazy_stts_first, sc->stts_count, sample);
+    sc->lazy_stts_index  = i;
+    sc->lazy_stts_sample = sample - sc->lazy_stts_first[i];
+
+    i = mov_lazy_search_first(sc->lazy_stsc_first, sc->stsc_count, sample);
+    n = sample - sc->lazy_stsc_first[i];
+    sc->lazy_stsc_index   = i;
+    sc->lazy_chunk        = sc->stsc_data[i].first - 1 + n / sc->stsc_data[i].count;
+    sc->lazy_chunk_sample = n % sc->stsc_data[i].count;
+    pos = sc->chunk_offsets[sc->lazy_chunk];
+    for (n = sample - sc->lazy_chunk_sample; n < sample; n++)
+        pos += mov_lazy_sample_size(sc, n);
+
+    /* first sync sample not before the current sample */
+    a = 0;
+    b = sc->keyframe_count;
+    while (a < b) {
+        unsigned int m = (a + b) >> 1;
+        if ((unsigned)sc->keyframes[m] < sample + sc->lazy_key_off)
+            a = m + 1;
+        else
+            b = m;
+    }
+    sc->lazy_stss_index = a;
+
+    mov_lazy_update_entry(sc, pos,
+                          sc->lazy_stts_first_dts[sc->lazy_stts_index] +
+                          (int64_t)sc->lazy_stts_sample * sc->stts_data[sc->lazy_stts_index].duration);
+}
+
+/* move from the previous sample to the current one */
+static void mov_lazy_next_sample(MOVStreamContext *sc)
+{
+    unsigned int sample = sc->current_sample;
+    int64_t pos = sc->lazy_entry.pos + sc->lazy_entry.size;
+    int64_t dts = sc->lazy_entry.timestamp + sc->stts_data[sc->lazy_stts_index].duration;
+
+    if (sc->current_sample <= 0 || sample >= sc->sample_count)
+        return;
+
+    if (++sc->lazy_stts_sample == sc->stts_data[sc->lazy_stts_index].count &&
+        sc->lazy_stts_index + 1 < sc->stts_count) {
+        sc->lazy_stts_sample = 0;
+        sc->lazy_stts_index++;
+    }
+    if (++sc->lazy_chunk_sample == sc->stsc_data[sc->lazy_stsc_index].count) {
+        sc->lazy_chunk_sample = 0;
+        sc->lazy_chunk++;
+        if (sc->lazy_stsc_index + 1 < sc->stsc_count &&
+            sc->lazy_chunk + 1 == sc->stsc_data[sc->lazy_stsc_index + 1].first)
+            sc->lazy_stsc_index++;
+        pos = sc->chunk_offsets[sc->lazy_chunk];
+    }
+    if (sc->lazy_stss_index < sc->keyframe_count &&
+        (unsigned)sc->keyframes[sc->lazy_stss_index] < sample + sc->lazy_key_off)
+        sc->lazy_stss_index++;
+
+    mov_lazy_update_entry(sc, pos, dts);
+}
+
+/**
+ * Find the sample of a lazily indexed stream like av_index_search_timestamp()
+ * does in a full index.
+ */
+static int mov_lazy_search_timestamp(MOVStreamContext *sc, int64_t timestamp, int flags)
+{
+    unsigned int a = 0, b = sc->stts_count, i, k;
+    int64_t n, sample, dts;
+
+    if (timestamp < sc->lazy_stts_first_dts[0]) {
+        sample = -1;
+        dts    = INT64_MIN;
+    } else {
+        while (b - a > 1) {
+            unsigned int m = (a + b) >> 1;
+            if (sc->lazy_stts_first_dts[m] <= timestamp)
+                a = m;
+            else
+                b = m;
+        }
+        i = a;
+        n = (timestamp - sc->lazy_stts_first_dts[i]) / sc->stts_data[i].duration;
+        if (i + 1 < sc->stts_count)
+            n = FFMIN(n, sc->stts_data[i].count - 1);
+        sample = FFMIN(sc->lazy_stts_first[i] + n, sc->sample_count - 1);
+        dts    = mov_lazy_sample_dts(sc, sample);
+    }
+
+    if (!(flags & AVSEEK_FLAG_BACKWARD) && dts != timestamp)
+        sample++;
+    if (sample < 0 || sample >= sc->sample_count)
+        return -1;
+    if ((flags & AVSEEK_FLAG_ANY) || sc->lazy_all_keyframes)
+        return sample;
+    if (sc->keyframe_absent)
+        return sample && (flags & AVSEEK_FLAG_BACKWARD) ? 0 : sample ? -1 : 0;
+
+    /* first sync sample not before the found sample */
+    a = 0;
+    b = sc->keyframe_count;
+    while (a < b) {
+        unsigned int m = (a + b) >> 1;
+        if (sc->keyframes[m] < sample + sc->lazy_key_off)
+            a = m + 1;
+        else
+            b = m;
+    }
+    k = a;
+    if (flags & AVSEEK_FLAG_BACKWARD) {
+        if (k == sc->keyframe_count || sc->keyframes[k] != sample + sc->lazy_key_off) {
+            if (!k)
+                return -1;
+            k--;
+        }
+    } else if (k == sc->keyframe_count) {
+        return -1;
+    }
+    sample = sc->keyframes[k] - sc->lazy_key_off;
+    return sample < sc->sample_count ? sample : -1;
+}
+
 #define MAX_REORDER_DELAY 16
 static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
     MOVStreamContext *msc = st->priv_data;
@@ -3261,11 +3632,15 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
     int buf_start = 0;
     int buf_size = 0;
     int j, r, num_swaps;
+    int nb_samples = msc->lazy_index ? msc->sample_count : st->nb_index_entries;
 
     if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
         st->codecpar->codec_id == AV_CODEC_ID_H264) {
         st->codecpar->video_delay = 0;
-        for(ind = 0; ind < st->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
+        for(ind = 0; ind < nb_samples && ctts_ind < msc->ctts_count; ++ind) {
+            int64_t dts = msc->lazy_index ? mov_lazy_sample_dts(msc, ind) :
+                                            st->index_entries[ind].timestamp;
+
             if (buf_size == (MAX_REORDER_DELAY + 1)) {
                 // If circular buffer is full, then move the first element forward.
                 buf_start = (buf_start + 1) % buf_size;
@@ -3275,7 +3650,7 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
 
             // Point j to the last elem of the buffer and insert the current pts there.
             j = (buf_start + buf_size - 1) % buf_size;
-            pts_buf[j] = st->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            pts_buf[j] = dts + msc->ctts_data[ctts_ind].duration;
 
             // The timestamps that are already in the sorted buffer, and are greater than the
             // current pts, are exactly the timestamps that need to be buffered to output PTS
@@ -3315,6 +3690,8 @@ static void mov_current_sample_inc(MOVStreamContext *sc)
         sc->current_index_range++;
         sc->current_index = sc->current_index_range->start;
     }
+    if (sc->lazy_index)
+        mov_lazy_next_sample(sc);
 }
 
 static void mov_current_sample_dec(MOVStreamContext *sc)
@@ -3327,6 +3704,8 @@ static void mov_current_sample_dec(MOVStreamContext *sc)
         sc->current_index_range--;
         sc->current_index = sc->current_index_range->end - 1;
     }
+    if (sc->lazy_index)
+        mov_lazy_set_sample(sc);
 }
 
 static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
@@ -3335,6 +3714,8 @@ static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
 
     sc->current_sample = current_sample;
     sc->current_index = current_sample;
+    if (sc->lazy_index)
+        mov_lazy_set_sample(sc);
     if (!sc->index_ranges) {
         return;
     }
@@ -3652,19 +4033,15 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
-static void mov_build_index(MOVContext *mov, AVStream *st)
+/**
+ * Set the time offset and the start padding of a stream from its edit list.
+ *
+ * @return the dts of the first sample of the stream
+ */
+static int64_t mov_edit_list_start(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
-    int64_t current_offset;
     int64_t current_dts = 0;
-    unsigned int stts_index = 0;
-    unsigned int stsc_index = 0;
-    unsigned int stss_index = 0;
-    unsigned int stps_index = 0;
-    unsigned int i, j;
-    uint64_t stream_size = 0;
-    MOVStts *ctts_data_old = sc->ctts_data;
-    unsigned int ctts_count_old = sc->ctts_count;
 
     if (sc->elst_count) {
         int i, edit_start_index = 0, multiple_edits = 0;
@@ -3704,6 +4081,25 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             sc->start_pad = start_time;
     }
 
+    return current_dts;
+}
+
+static void mov_build_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t current_offset;
+    int64_t current_dts;
+    unsigned int stts_index = 0;
+    unsigned int stsc_index = 0;
+    unsigned int stss_index = 0;
+    unsigned int stps_index = 0;
+    unsigned int i, j;
+    uint64_t stream_size = 0;
+    MOVStts *ctts_data_old = sc->ctts_data;
+    unsigned int ctts_count_old = sc->ctts_count;
+
+    current_dts = mov_edit_list_start(mov, st);
+
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
           sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
@@ -3965,6 +4361,178 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     mov_estimate_video_delay(mov, st);
 }
 
+/**
+ * Check that the samples of a stream can be located directly from its
+ * sample tables, with the same result as with mov_build_index().
+ */
+static int mov_lazy_index_supported(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    uint64_t samples = 0;
+    unsigned int i;
+
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+        st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+        return 0;
+    /* uncompressed audio chunks, edit lists applied to the index, partial
+     * sync samples, sample groups and stsd ids need the full index, except
+     * a single edit of the media from its start without composition offsets,
+     * which mov_fix_index() leaves unchanged if it covers all the samples */
+    if (!sc->sample_count || !sc->chunk_count || !sc->stts_count || !sc->stsc_count ||
+        (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+         sc->stts_count == 1 && sc->stts_data[0].duration == 1) ||
+        (sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist &&
+         (sc->elst_count > 1 || sc->elst_data[0].time || sc->ctts_data ||
+          mov->time_scale <= 0)) ||
+        sc->stps_count || sc->rap_group_count ||
+        (sc->stsz_sample_size > 0 && sc->sample_size > 0 &&
+         sc->stsz_sample_size != sc->sample_size) ||
+        sc->stsz_sample_size > 0x3FFFFFFF ||
+        (!sc->stsz_sample_size && !sc->sample_sizes))
+        return 0;
+
+    for (i = 0; i < sc->stts_count; i++) {
+        if (!sc->stts_data[i].count || sc->stts_data[i].duration <= 0)
+            return 0;
+        samples += sc->stts_data[i].count;
+    }
+    if (samples > UINT_MAX)
+        return 0;
+
+    if (sc->keyframe_count && sc->keyframes[0] < 0)
+        return 0;
+    for (i = 1; i < sc->keyframe_count; i++)
+        if (sc->keyframes[i] <= sc->keyframes[i - 1])
+            return 0;
+
+    samples = 0;
+    if (sc->stsc_data[0].first != 1)
+        return 0;
+    for (i = 0; i < sc->stsc_count; i++) {
+        unsigned int next = i + 1 < sc->stsc_count ? sc->stsc_data[i + 1].first :
+                                                     sc->chunk_count + 1;
+        if (sc->stsc_data[i].count <= 0 ||
+            next <= sc->stsc_data[i].first || next > sc->chunk_count + 1 ||
+            (sc->pseudo_stream_id != -1 &&
+             sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+        samples += (uint64_t)(next - sc->stsc_data[i].first) * sc->stsc_data[i].count;
+    }
+    return samples == sc->sample_count;
+}
+
+/**
+ * Prepare a stream for locating its samples from its sample tables.
+ *
+ * @return 1 if the stream is indexed lazily, 0 if it needs the full index
+ */
+static int mov_lazy_index_init(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    uint64_t stream_size = 0;
+    unsigned int i, first;
+    int64_t dts, edit_duration = -1;
+
+    if (!mov_lazy_index_supported(mov, st))
+        return 0;
+
+    if (!sc->stsz_sample_size) {
+        for (i = 0; i < sc->sample_count; i++) {
+            if ((unsigned)sc->sample_sizes[i] > 0x3FFFFFFF)
+                return 0;
+            stream_size += sc->sample_sizes[i];
+        }
+    } else
+        stream_size = (uint64_t)sc->stsz_sample_size * sc->sample_count;
+
+    sc->lazy_stts_first     = av_malloc_array(sc->stts_count, sizeof(*sc->lazy_stts_first));
+    sc->lazy_stts_first_dts = av_malloc_array(sc->stts_count, sizeof(*sc->lazy_stts_first_dts));
+    sc->lazy_stsc_first     = av_malloc_array(sc->stsc_count, sizeof(*sc->lazy_stsc_first));
+    if (!sc->lazy_stts_first || !sc->lazy_stts_first_dts || !sc->lazy_stsc_first) {
+        av_freep(&sc->lazy_stts_first);
+        av_freep(&sc->lazy_stts_first_dts);
+        av_freep(&sc->lazy_stsc_first);
+        return 0;
+    }
+
+    dts = mov_edit_list_start(mov, st) - sc->dts_shift;
+    for (i = 0, first = 0; i < sc->stts_count; i++) {
+        sc->lazy_stts_first[i]     = first;
+        sc->lazy_stts_first_dts[i] = dts;
+        first += sc->stts_data[i].count;
+        dts   += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+    }
+    for (i = 0, first = 0; i < sc->stsc_count; i++) {
+        unsigned int next = i + 1 < sc->stsc_count ? sc->stsc_data[i + 1].first :
+                                                     sc->chunk_count + 1;
+        sc->lazy_stsc_first[i] = first;
+        first += (next - sc->stsc_data[i].first) * sc->stsc_data[i].count;
+    }
+
+    if (sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist) {
+        edit_duration = av_rescale(sc->elst_data[0].duration, sc->time_scale,
+                                   mov->time_scale);
+        if (mov_lazy_sample_dts(sc, sc->sample_count - 1) >= edit_duration) {
+            av_freep(&sc->lazy_stts_first);
+            av_freep(&sc->lazy_stts_first_dts);
+            av_freep(&sc->lazy_stsc_first);
+            return 0;
+        }
+    }
+
+    sc->lazy_key_off       = sc->keyframe_count && sc->keyframes[0] > 0;
+    sc->lazy_all_keyframes = sc->keyframe_absent ?
+                             st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO :
+                             !sc->keyframe_count;
+    sc->lazy_index = 1;
+    mov_current_sample_set(sc, 0);
+
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+    if (edit_duration >= 0)
+        st->duration = edit_duration;
+
+    mov_estimate_video_delay(mov, st);
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d, %u samples indexed lazily\n",
+           st->index, sc->sample_count);
+    return 1;
+}
+
+static void mov_free_sample_tables(MOVStreamContext *sc)
+{
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->elst_data);
+    av_freep(&sc->rap_group);
+}
+
+/**
+ * Build the full index of a lazily indexed stream, for the code which needs
+ * it, e.g. fragments appending samples to it.
+ */
+static void mov_lazy_index_build(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (!sc->lazy_index)
+        return;
+    sc->lazy_index = 0;
+    av_freep(&sc->lazy_stts_first);
+    av_freep(&sc->lazy_stts_first_dts);
+    av_freep(&sc->lazy_stsc_first);
+
+    mov_build_index(mov, st);
+    mov_free_sample_tables(sc);
+    /* the ctts entries are now one per sample */
+    if (sc->ctts_data) {
+        sc->ctts_index  = sc->current_sample;
+        sc->ctts_sample = 0;
+    }
+}
+
 static int test_same_origin(const char *src, const char *ref) {
     char src_proto[64];
     char ref_proto[64];
@@ -4111,7 +4679,8 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     avpriv_set_pts_info(st, 64, 1, sc->time_scale);
 
-    mov_build_index(c, st);
+    if (!c->lazy_index || !mov_lazy_index_init(c, st))
+        mov_build_index(c, st);
 
     if (sc->dref_id-1 < sc->drefs_count && sc->drefs[sc->dref_id-1].path) {
         MOVDref *dref = &sc->drefs[sc->dref_id - 1];
@@ -4182,13 +4751,8 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
     /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
-    av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
+    if (!sc->lazy_index)
+        mov_free_sample_tables(sc);
 
     return 0;
 }
@@ -4612,6 +5176,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    mov_lazy_index_build(c, st);
 
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
@@ -6513,6 +7078,9 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        av_freep(&sc->lazy_stts_first);
+        av_freep(&sc->lazy_stts_first_dts);
+        av_freep(&sc->lazy_stsc_first);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -6729,9 +7297,26 @@ static int mov_read_header(AVFormatContext *s)
     }
     av_log(mov->fc, AV_LOG_TRACE, "on_parse_exit_offset=%"PRId64"\n", avio_tell(pb));
 
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+
+        /* fragments add their samples to the index */
+        if (mov->trex_data)
+            mov_lazy_index_build(mov, st);
+        if (sc->lazy_index && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+            for (j = 0; j < FFMIN(sc->sample_count, 99); j++)
+                ff_rfps_add_frame(s, st, mov_lazy_sample_dts(sc, j));
+    }
+
     if (pb->seekable & AVIO_SEEKABLE_NORMAL) {
-        if (mov->nb_chapter_tracks > 0 && !mov->ignore_chapters)
+        if (mov->nb_chapter_tracks > 0 && !mov->ignore_chapters) {
+            for (i = 0; i < s->nb_streams; i++)
+                for (j = 0; j < mov->nb_chapter_tracks; j++)
+                    if (s->streams[i]->id == mov->chapter_tracks[j])
+                        mov_lazy_index_build(mov, s->streams[i]);
             mov_read_chapters(s);
+        }
         for (i = 0; i < s->nb_streams; i++)
             if (s->streams[i]->codecpar->codec_tag == AV_RL32("tmcd")) {
                 mov_read_timecode_track(s, s->streams[i]);
@@ -6806,7 +7391,8 @@ static int mov_read_header(AVFormatContext *s)
         }
     }
 
-    if (mov->use_mfra_for > 0) {
+    if (mov->use_mfra_for > 0 ||
+        (mov->has_scanned_fragments && mov->frag_index.complete)) {
         for (i = 0; i < s->nb_streams; i++) {
             AVStream *st = s->streams[i];
             MOVStreamContext *sc = st->priv_data;
@@ -6891,6 +7477,7 @@ static int mov_read_header(AVFormatContext *s)
             break;
         }
     }
+    /* the streams with a lazy index have no entries and are not considered */
     ff_configure_buffers_for_index(s, AV_TIME_BASE);
 
     for (i = 0; i < mov->frag_index.nb_items; i++)
@@ -6900,6 +7487,17 @@ static int mov_read_header(AVFormatContext *s)
     return 0;
 }
 
+static AVIndexEntry *mov_get_current_sample(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->lazy_index)
+        return sc->current_sample >= 0 && sc->current_sample < sc->sample_count ?
+               &sc->lazy_entry : NULL;
+    return sc->current_sample < st->nb_index_entries ?
+           &st->index_entries[sc->current_sample] : NULL;
+}
+
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
     AVIndexEntry *sample = NULL;
@@ -6908,8 +7506,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        AVIndexEntry *current_sample = mov_get_current_sample(avst);
+        if (msc->pb && current_sample) {
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -6995,7 +7593,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry *sample, *next_sample, lazy_sample;
     AVStream *st = NULL;
     int64_t current_index;
     int ret;
@@ -7010,6 +7608,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         goto retry;
     }
     sc = st->priv_data;
+    if (sc->lazy_index) {
+        /* the entry is updated when moving to the next sample */
+        lazy_sample = *sample;
+        sample = &lazy_sample;
+    }
     /* must be done just before reading, to avoid infinite loop on sample */
     current_index = sc->current_index;
     mov_current_sample_inc(sc);
@@ -7084,8 +7687,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts;
+        next_sample = mov_get_current_sample(st);
+        next_dts = next_sample ? next_sample->timestamp : st->duration;
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
@@ -7145,6 +7749,60 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
     return 0;
 }
 
+static int mov_search_sample(AVStream *st, int64_t timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int sample;
+
+    if (sc->lazy_index) {
+        sample = mov_lazy_search_timestamp(sc, timestamp, flags);
+        if (sample < 0 && timestamp < sc->lazy_stts_first_dts[0])
+            sample = 0;
+    } else {
+        sample = av_index_search_timestamp(st, timestamp, flags);
+        if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+            sample = 0;
+    }
+    return sample;
+}
+
+/*
+ * When only some fragments are read, the first key frame at or after
+ * timestamp can be in a fragment following the one seeked to which was not
+ * read yet, so read them until the one starting after the sample found.
+ */
+static int mov_seek_fragments_forward(AVFormatContext *s, AVStream *st,
+                                      int64_t timestamp, int flags)
+{
+    MOVContext *mov = s->priv_data;
+    MOVStreamContext *sc = st->priv_data;
+    int sample = mov_search_sample(st, timestamp, flags);
+    int64_t frag_time;
+    int index, ret;
+
+    if (!mov->frag_index.complete || sc->lazy_index ||
+        (flags & AVSEEK_FLAG_BACKWARD))
+        return sample;
+
+    index = FFMAX(search_frag_timestamp(&mov->frag_index, st, timestamp), 0);
+    for (index++; index < mov->frag_index.nb_items; index++) {
+        frag_time = get_frag_time(&mov->frag_index, index, st->id);
+        if (sample >= 0 && frag_time != AV_NOPTS_VALUE &&
+            st->index_entries[sample].timestamp < frag_time)
+            break;
+        if (mov->frag_index.item[index].headers_read)
+            continue;
+        ret = mov_switch_root(s, -1, index);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        sample = mov_search_sample(st, timestamp, flags);
+    }
+
+    return sample;
+}
+
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -7157,10 +7815,8 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    sample = mov_seek_fragments_forward(s, st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
-        sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
     mov_current_sample_set(sc, sample);
@@ -7210,20 +7866,32 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         return sample;
 
     if (mc->seek_individually) {
-        /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
-
-        for (i = 0; i < s->nb_streams; i++) {
-            int64_t timestamp;
-            MOVStreamContext *sc = s->streams[i]->priv_data;
-            st = s->streams[i];
-            st->skip_samples = (sample_time <= 0) ? sc->start_pad : 0;
+        int64_t seek_timestamp;
+        int pass;
+
+        /* with lazy_fragments, the fragments read when seeking a stream can
+         * be inserted in the index before the samples found for the streams
+         * already seeked, so seek again once all the fragments needed are
+         * read */
+        for (pass = 0; pass < 1 + (mc->lazy_fragments && mc->frag_index.nb_items); pass++) {
+            st = s->streams[stream_index];
+            if (pass && (sample = mov_seek_stream(s, st, sample_time, flags)) < 0)
+                return sample;
+            /* adjust seek timestamp to found sample timestamp */
+            seek_timestamp = mov_get_current_sample(st)->timestamp;
+
+            for (i = 0; i < s->nb_streams; i++) {
+                int64_t timestamp;
+                MOVStreamContext *sc = s->streams[i]->priv_data;
+                st = s->streams[i];
+                st->skip_samples = (sample_time <= 0) ? sc->start_pad : 0;
 
-            if (stream_index == i)
-                continue;
+                if (stream_index == i)
+                    continue;
 
-            timestamp = av_rescale_q(seek_timestamp, s->streams[stream_index]->time_base, st->time_base);
-            mov_seek_stream(s, st, timestamp, flags);
+                timestamp = av_rescale_q(seek_timestamp, s->streams[stream_index]->time_base, st->time_base);
+                mov_seek_stream(s, st, timestamp, flags);
+            }
         }
     } else {
         for (i = 0; i < s->nb_streams; i++) {
@@ -7265,6 +7933,10 @@ static const AVOption mov_options[] = {
         0, 1, FLAGS},
     {"ignore_chapters", "", OFFSET(ignore_chapters), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
+    {"lazy_index",
+        "Locate the samples from the sample tables instead of building the index when possible.",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"use_mfra_for",
         "use mfra for fragment timestamps",
         OFFSET(use_mfra_for), AV_OPT_TYPE_INT, {.i64 = FF_MOV_FLAG_MFRA_AUTO},
@@ -7276,6 +7948,10 @@ static const AVOption mov_options[] = {
         FLAGS, "use_mfra_for" },
     {"pts", "pts", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_MFRA_PTS}, 0, 0,
         FLAGS, "use_mfra_for" },
+    {"lazy_fragments",
+        "Index the fragments from their headers and only parse the fragments which are read.",
+        OFFSET(lazy_fragments), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     { "export_all", "Export unrecognized metadata entries", OFFSET(export_all),
         AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, .flags = FLAGS },
     { "export_xmp", "Export full XMP metadata", OFFSET(export_xmp),
@@ -60,6 +60,7 @@ static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "faststart_duration", "expected duration, to reserve space for the moov atom with faststart", offsetof(MOVMuxContext, faststart_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "separate_moof", "Write separate moof/mdat atoms for each track", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SEPARATE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -132,9 +133,176 @@ static int64_t update_size(AVIOContext *pb, int64_t pos)
     return curpos - pos;
 }
 
-static int co64_required(const MOVTrack *track)
+#define MOV_INDEX_CHUNK_START 0x10
+#define MOV_INDEX_CONTIGUOUS  0x20
+#define MOV_INDEX_ONE_ENTRY   0x40
+#define MOV_INDEX_MAX_SIZE    41 ///< maximum size of a packed entry
+
+static void put_index_value(uint8_t **p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *(*p)++ = v | 0x80;
+        v >>= 7;
+    }
+    *(*p)++ = v;
+}
+
+static uint64_t get_index_value(const uint8_t **p)
+{
+    uint64_t v = 0;
+    int shift = 0;
+    while (**p & 0x80) {
+        v |= (uint64_t)(*(*p)++ & 0x7f) << shift;
+        shift += 7;
+    }
+    return v | (uint64_t)*(*p)++ << shift;
+}
+
+static void put_index_svalue(uint8_t **p, int64_t v)
+{
+    put_index_value(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static int64_t get_index_svalue(const uint8_t **p)
+{
+    uint64_t v = get_index_value(p);
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/**
+ * Pack the index entries of the completed chunks of a track, by pages of
+ * MOV_INDEX_CLUSTER_SIZE entries.
+ */
+static int mov_pack_index(MOVTrack *trk)
+{
+    while (trk->chunk_start - trk->packed_entries >= MOV_INDEX_CLUSTER_SIZE) {
+        int i, page = trk->packed_entries / MOV_INDEX_CLUSTER_SIZE;
+        int first_chunk = 1;
+        MOVIndexPage *pg;
+        uint64_t end;
+        int64_t dts;
+        uint8_t *buf, *p;
+
+        if (!trk->index_cache[0]) {
+            trk->index_cache[0] = av_malloc_array(MOV_INDEX_CLUSTER_SIZE, sizeof(MOVIentry));
+            trk->index_cache[1] = av_malloc_array(MOV_INDEX_CLUSTER_SIZE, sizeof(MOVIentry));
+            if (!trk->index_cache[0] || !trk->index_cache[1])
+                return AVERROR(ENOMEM);
+        }
+        if (page >= trk->index_pages_capacity) {
+            unsigned new_capacity = 2 * page + 16;
+            if (av_reallocp_array(&trk->index_pages, new_capacity,
+                                  sizeof(*trk->index_pages)) < 0)
+                return AVERROR(ENOMEM);
+            trk->index_pages_capacity = new_capacity;
+        }
+        if ((uint64_t)trk->index_buf_size + MOV_INDEX_CLUSTER_SIZE * MOV_INDEX_MAX_SIZE > UINT_MAX)
+            return AVERROR(ENOMEM);
+        buf = av_fast_realloc(trk->index_buf, &trk->index_buf_allocated,
+                              trk->index_buf_size + MOV_INDEX_CLUSTER_SIZE * MOV_INDEX_MAX_SIZE);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        trk->index_buf = buf;
+
+        pg = &trk->index_pages[page];
+        pg->pos    = end = trk->cluster[0].pos;
+        pg->dts    = dts = trk->cluster[0].dts;
+        pg->chunks = 0;
+        pg->offset = trk->index_buf_size;
+        p = buf + trk->index_buf_size;
+        for (i = 0; i < MOV_INDEX_CLUSTER_SIZE; i++) {
+            const MOVIentry *e = &trk->cluster[i];
+            int flags = e->flags;
+
+            if (e->chunkNum) {
+                /* chunks are numbered consecutively */
+                if (first_chunk)
+                    pg->chunks = e->chunkNum - 1;
+                first_chunk = 0;
+                flags |= MOV_INDEX_CHUNK_START;
+            }
+            if (e->pos == end)
+                flags |= MOV_INDEX_CONTIGUOUS;
+            if (e->entries == 1)
+                flags |= MOV_INDEX_ONE_ENTRY;
+            *p++ = flags;
+            put_index_value(&p, e->size);
+            if (!(flags & MOV_INDEX_CONTIGUOUS))
+                put_index_svalue(&p, e->pos - end);
+            put_index_svalue(&p, e->dts - dts);
+            put_index_svalue(&p, e->cts);
+            if (!(flags & MOV_INDEX_ONE_ENTRY))
+                put_index_value(&p, e->entries);
+            if (flags & MOV_INDEX_CHUNK_START)
+                put_index_value(&p, e->samples_in_chunk);
+            end = e->pos + e->size;
+            dts = e->dts;
+        }
+        trk->index_buf_size = p - buf;
+
+        memmove(trk->cluster, trk->cluster + MOV_INDEX_CLUSTER_SIZE,
+                (trk->entry - trk->packed_entries - MOV_INDEX_CLUSTER_SIZE) * sizeof(*trk->cluster));
+        trk->packed_entries += MOV_INDEX_CLUSTER_SIZE;
+    }
+    return 0;
+}
+
+static void mov_unpack_index_page(MOVTrack *trk, int page, MOVIentry *e)
+{
+    const MOVIndexPage *pg = &trk->index_pages[page];
+    const uint8_t *p = trk->index_buf + pg->offset;
+    uint64_t end = pg->pos;
+    int64_t dts = pg->dts;
+    unsigned chunks = pg->chunks;
+    int i;
+
+    for (i = 0; i < MOV_INDEX_CLUSTER_SIZE; i++) {
+        int flags = *p++;
+
+        e[i].size = get_index_value(&p);
+        e[i].pos  = end;
+        if (!(flags & MOV_INDEX_CONTIGUOUS))
+            e[i].pos += get_index_svalue(&p);
+        dts += get_index_svalue(&p);
+        e[i].dts     = dts;
+        e[i].cts     = get_index_svalue(&p);
+        e[i].entries = flags & MOV_INDEX_ONE_ENTRY ? 1 : get_index_value(&p);
+        e[i].samples_in_chunk = e[i].entries;
+        e[i].chunkNum         = 0;
+        if (flags & MOV_INDEX_CHUNK_START) {
+            e[i].chunkNum         = ++chunks;
+            e[i].samples_in_chunk = get_index_value(&p);
+        }
+        e[i].flags = flags & (MOV_SYNC_SAMPLE | MOV_PARTIAL_SYNC_SAMPLE |
+                              MOV_DISPOSABLE_SAMPLE);
+        end = e[i].pos + e[i].size;
+    }
+}
+
+/**
+ * Get an index entry of a track, which may have been packed.
+ * The pointer is valid until another packed entry is accessed, unless it
+ * is in the next or previous page.
+ */
+static MOVIentry *mov_get_entry(MOVTrack *trk, int idx)
+{
+    int page, slot;
+
+    if (idx >= trk->packed_entries)
+        return &trk->cluster[idx - trk->packed_entries];
+
+    page = idx / MOV_INDEX_CLUSTER_SIZE;
+    slot = page & 1;
+    if (trk->index_cache_page[slot] != page + 1) {
+        mov_unpack_index_page(trk, page, trk->index_cache[slot]);
+        trk->index_cache_page[slot] = page + 1;
+    }
+    return &trk->index_cache[slot][idx % MOV_INDEX_CLUSTER_SIZE];
+}
+
+static int co64_required(MOVTrack *track)
 {
-    if (track->entry > 0 && track->cluster[track->entry - 1].pos + track->data_offset > UINT32_MAX)
+    if (track->entry > 0 && mov_get_entry(track, track->entry - 1)->pos + track->data_offset > UINT32_MAX)
         return 1;
     return 0;
 }
@@ -153,12 +321,12 @@ static int mov_write_stco_tag(AVIOContext *pb, MOVTrack *track)
     avio_wb32(pb, 0); /* version & flags */
     avio_wb32(pb, track->chunkCount); /* entry count */
     for (i = 0; i < track->entry; i++) {
-        if (!track->cluster[i].chunkNum)
+        if (!mov_get_entry(track, i)->chunkNum)
             continue;
         if (mode64 == 1)
-            avio_wb64(pb, track->cluster[i].pos + track->data_offset);
+            avio_wb64(pb, mov_get_entry(track, i)->pos + track->data_offset);
         else
-            avio_wb32(pb, track->cluster[i].pos + track->data_offset);
+            avio_wb32(pb, mov_get_entry(track, i)->pos + track->data_offset);
     }
     return update_size(pb, pos);
 }
@@ -175,14 +343,14 @@ static int mov_write_stsz_tag(AVIOContext *pb, MOVTrack *track)
     avio_wb32(pb, 0); /* version & flags */
 
     for (i = 0; i < track->entry; i++) {
-        tst = track->cluster[i].size / track->cluster[i].entries;
+        tst = mov_get_entry(track, i)->size / mov_get_entry(track, i)->entries;
         if (oldtst != -1 && tst != oldtst)
             equalChunks = 0;
         oldtst = tst;
-        entries += track->cluster[i].entries;
+        entries += mov_get_entry(track, i)->entries;
     }
     if (equalChunks && track->entry) {
-        int sSize = track->entry ? track->cluster[0].size / track->cluster[0].entries : 0;
+        int sSize = track->entry ? mov_get_entry(track, 0)->size / mov_get_entry(track, 0)->entries : 0;
         sSize = FFMAX(1, sSize); // adpcm mono case could make sSize == 0
         avio_wb32(pb, sSize); // sample size
         avio_wb32(pb, entries); // sample count
@@ -190,9 +358,9 @@ static int mov_write_stsz_tag(AVIOContext *pb, MOVTrack *track)
         avio_wb32(pb, 0); // sample size
         avio_wb32(pb, entries); // sample count
         for (i = 0; i < track->entry; i++) {
-            for (j = 0; j < track->cluster[i].entries; j++) {
-                avio_wb32(pb, track->cluster[i].size /
-                          track->cluster[i].entries);
+            for (j = 0; j < mov_get_entry(track, i)->entries; j++) {
+                avio_wb32(pb, mov_get_entry(track, i)->size /
+                          mov_get_entry(track, i)->entries);
             }
         }
     }
@@ -212,11 +380,11 @@ static int mov_write_stsc_tag(AVIOContext *pb, MOVTrack *track)
     entryPos = avio_tell(pb);
     avio_wb32(pb, track->chunkCount); // entry count
     for (i = 0; i < track->entry; i++) {
-        if (oldval != track->cluster[i].samples_in_chunk && track->cluster[i].chunkNum) {
-            avio_wb32(pb, track->cluster[i].chunkNum); // first chunk
-            avio_wb32(pb, track->cluster[i].samples_in_chunk); // samples per chunk
+        if (oldval != mov_get_entry(track, i)->samples_in_chunk && mov_get_entry(track, i)->chunkNum) {
+            avio_wb32(pb, mov_get_entry(track, i)->chunkNum); // first chunk
+            avio_wb32(pb, mov_get_entry(track, i)->samples_in_chunk); // samples per chunk
             avio_wb32(pb, 0x1); // sample description index
-            oldval = track->cluster[i].samples_in_chunk;
+            oldval = mov_get_entry(track, i)->samples_in_chunk;
             index++;
         }
     }
@@ -240,7 +408,7 @@ static int mov_write_stss_tag(AVIOContext *pb, MOVTrack *track, uint32_t flag)
     entryPos = avio_tell(pb);
     avio_wb32(pb, track->entry); // entry count
     for (i = 0; i < track->entry; i++) {
-        if (track->cluster[i].flags & flag) {
+        if (mov_get_entry(track, i)->flags & flag) {
             avio_wb32(pb, i + 1);
             index++;
         }
@@ -264,10 +432,10 @@ static int mov_write_sdtp_tag(AVIOContext *pb, MOVTrack *track)
     for (i = 0; i < track->entry; i++) {
         dependent = MOV_SAMPLE_DEPENDENCY_YES;
         leading = reference = redundancy = MOV_SAMPLE_DEPENDENCY_UNKNOWN;
-        if (track->cluster[i].flags & MOV_DISPOSABLE_SAMPLE) {
+        if (mov_get_entry(track, i)->flags & MOV_DISPOSABLE_SAMPLE) {
             reference = MOV_SAMPLE_DEPENDENCY_NO;
         }
-        if (track->cluster[i].flags & MOV_SYNC_SAMPLE) {
+        if (mov_get_entry(track, i)->flags & MOV_SYNC_SAMPLE) {
             dependent = MOV_SAMPLE_DEPENDENCY_NO;
         }
         avio_w8(pb, (leading << 6)   | (dependent << 4) |
@@ -600,7 +768,7 @@ static unsigned compute_avg_bitrate(MOVTrack *track)
     if (!track->track_duration)
         return 0;
     for (i = 0; i < track->entry; i++)
-        size += track->cluster[i].size;
+        size += mov_get_entry(track, i)->size;
     return size * 8 * track->timescale / track->track_duration;
 }
 
@@ -960,9 +1128,9 @@ static int get_cluster_duration(MOVTrack *track, int cluster_idx)
     if (cluster_idx + 1 == track->entry)
         next_dts = track->track_duration + track->start_dts;
     else
-        next_dts = track->cluster[cluster_idx + 1].dts;
+        next_dts = mov_get_entry(track, cluster_idx + 1)->dts;
 
-    next_dts -= track->cluster[cluster_idx].dts;
+    next_dts -= mov_get_entry(track, cluster_idx)->dts;
 
     av_assert0(next_dts >= 0);
     av_assert0(next_dts <= INT_MAX);
@@ -2187,13 +2355,13 @@ static int mov_write_ctts_tag(AVFormatContext *s, AVIOContext *pb, MOVTrack *tra
     if (!ctts_entries)
         return AVERROR(ENOMEM);
     ctts_entries[0].count = 1;
-    ctts_entries[0].duration = track->cluster[0].cts;
+    ctts_entries[0].duration = mov_get_entry(track, 0)->cts;
     for (i = 1; i < track->entry; i++) {
-        if (track->cluster[i].cts == ctts_entries[entries].duration) {
+        if (mov_get_entry(track, i)->cts == ctts_entries[entries].duration) {
             ctts_entries[entries].count++; /* compress */
         } else {
             entries++;
-            ctts_entries[entries].duration = track->cluster[i].cts;
+            ctts_entries[entries].duration = mov_get_entry(track, i)->cts;
             ctts_entries[entries].count = 1;
         }
     }
@@ -2874,14 +3042,14 @@ static int mov_write_edts_tag(AVIOContext *pb, MOVMuxContext *mov,
     int64_t start_dts = track->start_dts;
 
     if (track->entry) {
-        if (start_dts != track->cluster[0].dts || start_ct != track->cluster[0].cts) {
+        if (start_dts != mov_get_entry(track, 0)->dts || start_ct != mov_get_entry(track, 0)->cts) {
 
             av_log(mov->fc, AV_LOG_DEBUG,
                    "EDTS using dts:%"PRId64" cts:%d instead of dts:%"PRId64" cts:%"PRId64" tid:%d\n",
-                   track->cluster[0].dts, track->cluster[0].cts,
+                   mov_get_entry(track, 0)->dts, mov_get_entry(track, 0)->cts,
                    start_dts, start_ct, track->track_id);
-            start_dts = track->cluster[0].dts;
-            start_ct  = track->cluster[0].cts;
+            start_dts = mov_get_entry(track, 0)->dts;
+            start_ct  = mov_get_entry(track, 0)->cts;
         }
     }
 
@@ -3061,7 +3229,7 @@ static int mov_write_trak_tag(AVFormatContext *s, AVIOContext *pb, MOVMuxContext
     if (track->start_dts != AV_NOPTS_VALUE) {
         if (mov->use_editlist)
             mov_write_edts_tag(pb, mov, track);  // PSP Movies and several other cases require edts box
-        else if ((track->entry && track->cluster[0].dts) || track->mode == MODE_PSP || is_clcp_track(track))
+        else if ((track->entry && mov_get_entry(track, 0)->dts) || track->mode == MODE_PSP || is_clcp_track(track))
             av_log(mov->fc, AV_LOG_WARNING,
                    "Not writing any edit list even though one would have been required\n");
     }
@@ -3822,7 +3990,7 @@ static int mov_write_moov_tag(AVIOContext *pb, MOVMuxContext *mov,
 
         mov->tracks[i].time     = mov->time;
 
-        if (mov->tracks[i].entry)
+        if (mov->tracks[i].entry && !mov->tracks[i].pack_index)
             build_chunks(&mov->tracks[i]);
     }
 
@@ -5063,7 +5231,7 @@ static int check_pkt(AVFormatContext *s, AVPacket *pkt)
     uint64_t duration;
 
     if (trk->entry) {
-        ref = trk->cluster[trk->entry - 1].dts;
+        ref = mov_get_entry(trk, trk->entry - 1)->dts;
     } else if (   trk->start_dts != AV_NOPTS_VALUE
                && !trk->frag_discont) {
         ref = trk->start_dts + trk->track_duration;
@@ -5099,6 +5267,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     AVIOContext *pb = s->pb;
     MOVTrack *trk = &mov->tracks[pkt->stream_index];
     AVCodecParameters *par = trk->par;
+    MOVIentry *sample;
     unsigned int samples_in_chunk = 0;
     int size = pkt->size, ret = 0;
     uint8_t *reformatted_data = NULL;
@@ -5241,8 +5410,8 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         memcpy(trk->vos_data, pkt->data, size);
     }
 
-    if (trk->entry >= trk->cluster_capacity) {
-        unsigned new_capacity = 2 * (trk->entry + MOV_INDEX_CLUSTER_SIZE);
+    if (trk->entry - trk->packed_entries >= trk->cluster_capacity) {
+        unsigned new_capacity = 2 * (trk->entry - trk->packed_entries + MOV_INDEX_CLUSTER_SIZE);
         if (av_reallocp_array(&trk->cluster, new_capacity,
                               sizeof(*trk->cluster))) {
             ret = AVERROR(ENOMEM);
@@ -5250,20 +5419,21 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
         trk->cluster_capacity = new_capacity;
     }
+    sample = &trk->cluster[trk->entry - trk->packed_entries];
 
-    trk->cluster[trk->entry].pos              = avio_tell(pb) - size;
-    trk->cluster[trk->entry].samples_in_chunk = samples_in_chunk;
-    trk->cluster[trk->entry].chunkNum         = 0;
-    trk->cluster[trk->entry].size             = size;
-    trk->cluster[trk->entry].entries          = samples_in_chunk;
-    trk->cluster[trk->entry].dts              = pkt->dts;
+    sample->pos              = avio_tell(pb) - size;
+    sample->samples_in_chunk = samples_in_chunk;
+    sample->chunkNum         = 0;
+    sample->size             = size;
+    sample->entries          = samples_in_chunk;
+    sample->dts              = pkt->dts;
     if (!trk->entry && trk->start_dts != AV_NOPTS_VALUE) {
         if (!trk->frag_discont) {
             /* First packet of a new fragment. We already wrote the duration
              * of the last packet of the previous fragment based on track_duration,
              * which might not exactly match our dts. Therefore adjust the dts
              * of this packet to be what the previous packets duration implies. */
-            trk->cluster[trk->entry].dts = trk->start_dts + trk->track_duration;
+            sample->dts = trk->start_dts + trk->track_duration;
             /* We also may have written the pts and the corresponding duration
              * in sidx/tfrf/tfxd tags; make sure the sidx pts and duration match up with
              * the next fragment. This means the cts of the first sample must
@@ -5271,7 +5441,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
              * the packet causing the fragment to be written. */
             if ((mov->flags & FF_MOV_FLAG_DASH && !(mov->flags & FF_MOV_FLAG_GLOBAL_SIDX)) ||
                 mov->mode == MODE_ISM)
-                pkt->pts = pkt->dts + trk->end_pts - trk->cluster[trk->entry].dts;
+                pkt->pts = pkt->dts + trk->end_pts - sample->dts;
         } else {
             /* New fragment, but discontinuous from previous fragments.
              * Pretend the duration sum of the earlier fragments is
@@ -5289,7 +5459,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
          * to signal the difference in starting time without an edit list.
          * Thus move the timestamp for this first sample to 0, increasing
          * its duration instead. */
-        trk->cluster[trk->entry].dts = trk->start_dts = 0;
+        sample->dts = trk->start_dts = 0;
     }
     if (trk->start_dts == AV_NOPTS_VALUE) {
         trk->start_dts = pkt->dts;
@@ -5323,16 +5493,16 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
     if (pkt->dts != pkt->pts)
         trk->flags |= MOV_TRACK_CTTS;
-    trk->cluster[trk->entry].cts   = pkt->pts - pkt->dts;
-    trk->cluster[trk->entry].flags = 0;
+    sample->cts   = pkt->pts - pkt->dts;
+    sample->flags = 0;
     if (trk->start_cts == AV_NOPTS_VALUE)
         trk->start_cts = pkt->pts - pkt->dts;
     if (trk->end_pts == AV_NOPTS_VALUE)
-        trk->end_pts = trk->cluster[trk->entry].dts +
-                       trk->cluster[trk->entry].cts + pkt->duration;
+        trk->end_pts = sample->dts +
+                       sample->cts + pkt->duration;
     else
-        trk->end_pts = FFMAX(trk->end_pts, trk->cluster[trk->entry].dts +
-                                           trk->cluster[trk->entry].cts +
+        trk->end_pts = FFMAX(trk->end_pts, sample->dts +
+                                           sample->cts +
                                            pkt->duration);
 
     if (par->codec_id == AV_CODEC_ID_VC1) {
@@ -5340,23 +5510,39 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     } else if (pkt->flags & AV_PKT_FLAG_KEY) {
         if (mov->mode == MODE_MOV && par->codec_id == AV_CODEC_ID_MPEG2VIDEO &&
             trk->entry > 0) { // force sync sample for the first key frame
-            mov_parse_mpeg2_frame(pkt, &trk->cluster[trk->entry].flags);
-            if (trk->cluster[trk->entry].flags & MOV_PARTIAL_SYNC_SAMPLE)
+            mov_parse_mpeg2_frame(pkt, &sample->flags);
+            if (sample->flags & MOV_PARTIAL_SYNC_SAMPLE)
                 trk->flags |= MOV_TRACK_STPS;
         } else {
-            trk->cluster[trk->entry].flags = MOV_SYNC_SAMPLE;
+            sample->flags = MOV_SYNC_SAMPLE;
         }
-        if (trk->cluster[trk->entry].flags & MOV_SYNC_SAMPLE)
+        if (sample->flags & MOV_SYNC_SAMPLE)
             trk->has_keyframes++;
     }
     if (pkt->flags & AV_PKT_FLAG_DISPOSABLE) {
-        trk->cluster[trk->entry].flags |= MOV_DISPOSABLE_SAMPLE;
+        sample->flags |= MOV_DISPOSABLE_SAMPLE;
         trk->has_disposable++;
     }
+    if (trk->pack_index) {
+        /* build the chunks as the samples come, like build_chunks() */
+        MOVIentry *chunk = mov_get_entry(trk, trk->chunk_start);
+        if (trk->entry && chunk->pos + trk->chunk_size == sample->pos &&
+            trk->chunk_size + size < (1 << 20)) {
+            trk->chunk_size         += size;
+            chunk->samples_in_chunk += samples_in_chunk;
+        } else {
+            sample->chunkNum = ++trk->chunkCount;
+            trk->chunk_start = trk->entry;
+            trk->chunk_size  = size;
+        }
+    }
     trk->entry++;
     trk->sample_count += samples_in_chunk;
     mov->mdat_size    += size;
 
+    if (trk->pack_index && (ret = mov_pack_index(trk)) < 0)
+        goto err;
+
     if (trk->hint_track >= 0 && trk->hint_track < mov->nb_streams)
         ff_mov_add_hinted_packet(s, pkt, trk->hint_track, trk->entry,
                                  reformatted_data, size);
@@ -5424,7 +5610,7 @@ static int mov_write_single_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         if (trk->entry && pkt->stream_index < s->nb_streams)
-            frag_duration = av_rescale_q(pkt->dts - trk->cluster[0].dts,
+            frag_duration = av_rescale_q(pkt->dts - mov_get_entry(trk, 0)->dts,
                                          s->streams[pkt->stream_index]->time_base,
                                          AV_TIME_BASE_Q);
         if ((mov->max_fragment_duration &&
@@ -5769,6 +5955,10 @@ static void mov_free(AVFormatContext *s)
         else if (mov->tracks[i].tag == MKTAG('t','m','c','d') && mov->nb_meta_tmcd)
             av_freep(&mov->tracks[i].par);
         av_freep(&mov->tracks[i].cluster);
+        av_freep(&mov->tracks[i].index_pages);
+        av_freep(&mov->tracks[i].index_buf);
+        av_freep(&mov->tracks[i].index_cache[0]);
+        av_freep(&mov->tracks[i].index_cache[1]);
         av_freep(&mov->tracks[i].frag_info);
 
         if (mov->tracks[i].vos_len)
@@ -5891,7 +6081,11 @@ static int mov_init(AVFormatContext *s)
     }
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-        mov->reserved_moov_size = -1;
+        /* With a reserved or predicted moov size, the data is only moved if
+         * the moov atom does not fit in the reserved space. */
+        if (mov->flags & FF_MOV_FLAG_FRAGMENT ||
+            (mov->reserved_moov_size <= 0 && !mov->faststart_duration))
+            mov->reserved_moov_size = -1;
     }
 
     if (mov->use_editlist < 0) {
@@ -6030,6 +6224,8 @@ static int mov_init(AVFormatContext *s)
         /* If hinting of this track is enabled by a later hint track,
          * this is updated. */
         track->hint_track = -1;
+        track->pack_index = !(mov->flags & FF_MOV_FLAG_FRAGMENT) &&
+                            st->codecpar->codec_id != AV_CODEC_ID_VC1;
         track->start_dts  = AV_NOPTS_VALUE;
         track->start_cts  = AV_NOPTS_VALUE;
         track->end_pts    = AV_NOPTS_VALUE;
@@ -6160,6 +6356,48 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/* reserving more is not worth it, a larger moov atom only moves the data */
+#define MAX_ESTIMATED_MOOV_SIZE (64 << 20)
+
+/*
+ * Predict the size of the moov atom of a file of the given expected duration,
+ * from the number of samples per track: this assumes one chunk per sample and
+ * counts the sample size, chunk offset, composition offset and sync sample
+ * entries of every video sample, so it rather overestimates the size.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    double duration = mov->faststart_duration / (double)AV_TIME_BASE;
+    double size = 4096;
+    int i;
+
+    for (i = 0; i < mov->nb_streams; i++) {
+        AVStream *st = i < s->nb_streams ? s->streams[i] : NULL;
+        double rate = 1;
+        int entry_size = 8;
+
+        size += 1024;
+        if (!st)
+            continue;
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+                rate = av_q2d(st->avg_frame_rate);
+            else
+                rate = 60;
+            entry_size = 20;
+        } else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            int frame_size = st->codecpar->frame_size > 0 ?
+                             st->codecpar->frame_size : 1024;
+            rate = st->codecpar->sample_rate > 0 ?
+                   st->codecpar->sample_rate / (double)frame_size : 50;
+        }
+        size += duration * rate * entry_size;
+    }
+
+    return FFMIN(size, MAX_ESTIMATED_MOOV_SIZE);
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -6229,6 +6467,12 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
+    if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->reserved_moov_size) {
+        mov->reserved_moov_size = estimate_moov_size(s);
+        av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n",
+               mov->reserved_moov_size);
+    }
+
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
         if (mov->reserved_moov_size > 0)
@@ -6242,7 +6486,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6336,9 +6580,10 @@ static int get_sidx_size(AVFormatContext *s)
  * This function gets the moov size if moved to the top of the file: the chunk
  * offset table can switch between stco (32-bit entries) to co64 (64-bit
  * entries) when the moov is moved to the beginning, so the size of the moov
- * would change. It also updates the chunk offset tables.
+ * would change. It also updates the chunk offset tables. The data is moved by
+ * the size of the moov minus the size of the space already reserved for it.
  */
-static int compute_moov_size(AVFormatContext *s)
+static int compute_moov_size(AVFormatContext *s, int reserved)
 {
     int i, moov_size, moov_size2;
     MOVMuxContext *mov = s->priv_data;
@@ -6348,7 +6593,7 @@ static int compute_moov_size(AVFormatContext *s)
         return moov_size;
 
     for (i = 0; i < mov->nb_streams; i++)
-        mov->tracks[i].data_offset += moov_size;
+        mov->tracks[i].data_offset += moov_size - reserved;
 
     moov_size2 = get_moov_size(s);
     if (moov_size2 < 0)
@@ -6378,9 +6623,13 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
-static int shift_data(AVFormatContext *s)
+/*
+ * Move the data following the reserved space at reserved_header_pos, so that
+ * moov_size bytes are available there for the moov or sidx atoms.
+ */
+static int shift_data(AVFormatContext *s, int reserved)
 {
-    int ret = 0, moov_size;
+    int ret = 0, moov_size, shift, block_size;
     MOVMuxContext *mov = s->priv_data;
     int64_t pos, pos_end = avio_tell(s->pb);
     uint8_t *buf, *read_buf[2];
@@ -6391,15 +6640,19 @@ static int shift_data(AVFormatContext *s)
     if (mov->flags & FF_MOV_FLAG_FRAGMENT)
         moov_size = compute_sidx_size(s);
     else
-        moov_size = compute_moov_size(s);
+        moov_size = compute_moov_size(s, reserved);
     if (moov_size < 0)
         return moov_size;
+    shift = moov_size - reserved;
 
-    buf = av_malloc(moov_size * 2);
+    /* the blocks must not be smaller than the shift, since a block is only
+     * written once the next one has been read */
+    block_size = FFMAX(shift, 1 << 16);
+    buf = av_malloc(block_size * 2);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + block_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -6417,16 +6670,16 @@ static int shift_data(AVFormatContext *s)
     pos_end = avio_tell(s->pb);
     avio_seek(s->pb, mov->reserved_header_pos + moov_size, SEEK_SET);
 
-    /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_header_pos, SEEK_SET);
+    /* start reading at the end of the reserved space */
+    avio_seek(read_pb, mov->reserved_header_pos + reserved, SEEK_SET);
     pos = avio_tell(read_pb);
 
-#define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
-    read_buf_id ^= 1;                                                               \
+#define READ_BLOCK do {                                                              \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], block_size);  \
+    read_buf_id ^= 1;                                                                \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of block_size */
     READ_BLOCK;
     do {
         int n;
@@ -6439,6 +6692,9 @@ static int shift_data(AVFormatContext *s)
     } while (pos < pos_end);
     ff_format_io_close(s, &read_pb);
 
+    av_log(s, AV_LOG_INFO, "Moved %"PRId64" bytes of data by %d bytes\n",
+           pos - mov->reserved_header_pos - reserved, shift);
+
 end:
     av_free(buf);
     return ret;
@@ -6508,9 +6764,44 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            /* the moov atom must fill the reserved space exactly or leave
+             * room for a free atom */
+            if (moov_size == mov->reserved_moov_size ||
+                moov_size + 8 <= mov->reserved_moov_size) {
+                av_log(s, AV_LOG_INFO, "Writing the moov atom in the reserved space, "
+                       "no data moved\n");
+            } else {
+                /* If the moov atom fits but leaves less than 8 bytes, move
+                 * the data by the few bytes missing for the free atom,
+                 * taking the end of the reserved space along with it. */
+                const int fits = moov_size < mov->reserved_moov_size;
+
+                av_log(s, AV_LOG_INFO, "The reserved space of %d bytes is too "
+                       "small for the moov atom of %d bytes%s\n",
+                       mov->reserved_moov_size, moov_size,
+                       fits ? " and a free atom" : "");
+                avio_seek(pb, moov_pos, SEEK_SET);
+                res = shift_data(s, mov->reserved_moov_size - (fits ? 8 : 0));
+                if (res < 0)
+                    return res;
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                if (fits) {
+                    if ((moov_size = get_moov_size(s)) < 0)
+                        return moov_size;
+                    mov->reserved_moov_size = moov_size + 8;
+                } else {
+                    mov->reserved_moov_size = 0;
+                }
+            }
+        }
+
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
+            res = shift_data(s, 0);
             if (res < 0)
                 return res;
             avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
@@ -6521,13 +6812,15 @@ static int mov_write_trailer(AVFormatContext *s)
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
             size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
-            if (size < 8){
+            if (size && size < 8){
                 av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
                 return AVERROR(EINVAL);
             }
-            avio_wb32(pb, size);
-            ffio_wfourcc(pb, "free");
-            ffio_fill(pb, 0, size - 8);
+            if (size) {
+                avio_wb32(pb, size);
+                ffio_wfourcc(pb, "free");
+                ffio_fill(pb, 0, size - 8);
+            }
             avio_seek(pb, moov_pos, SEEK_SET);
         } else {
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
@@ -6541,7 +6834,7 @@ static int mov_write_trailer(AVFormatContext *s)
         if (mov->flags & FF_MOV_FLAG_GLOBAL_SIDX) {
             int64_t end;
             av_log(s, AV_LOG_INFO, "Starting second pass: inserting sidx atoms\n");
-            res = shift_data(s);
+            res = shift_data(s, 0);
             if (res < 0)
                 return res;
             end = avio_tell(pb);
@@ -57,6 +57,19 @@ typedef struct MOVIentry {
     uint32_t     flags;
 } MOVIentry;
 
+/**
+ * The index entries of a track which can't change anymore, i.e. those before
+ * the current chunk, can be packed by pages of MOV_INDEX_CLUSTER_SIZE
+ * entries, delta and variable length coded, which bounds the memory used for
+ * long non-fragmented files.
+ */
+typedef struct MOVIndexPage {
+    uint64_t     pos;       ///< position of the first sample of the page
+    int64_t      dts;       ///< dts of the first sample of the page
+    unsigned int chunks;    ///< number of chunks started before the page
+    unsigned int offset;    ///< offset of the page in MOVTrack.index_buf
+} MOVIndexPage;
+
 typedef struct HintSample {
     uint8_t *data;
     int size;
@@ -108,8 +121,19 @@ typedef struct MOVTrack {
 
     int         vos_len;
     uint8_t     *vos_data;
-    MOVIentry   *cluster;
+    MOVIentry   *cluster;   ///< entries from packed_entries on
     unsigned    cluster_capacity;
+    int         pack_index;
+    int         packed_entries;
+    MOVIndexPage *index_pages;
+    unsigned    index_pages_capacity;
+    uint8_t     *index_buf;
+    unsigned    index_buf_size;
+    unsigned    index_buf_allocated;
+    MOVIentry   *index_cache[2];     ///< unpacked pages, by parity of the page number
+    int         index_cache_page[2]; ///< page number + 1 of the unpacked pages
+    int         chunk_start;         ///< first entry of the current chunk
+    uint64_t    chunk_size;          ///< size of the current chunk
     int         audio_vbr;
     int         height; ///< active picture (w/o VBI) height for D-10/IMX
     uint32_t    tref_tag;
@@ -198,6 +222,7 @@ typedef struct MOVMuxContext {
     int video_track_timescale;
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
+    int64_t faststart_duration; ///< expected duration, to predict reserved_moov_size
     int64_t reserved_header_pos;
 
     char *major_brand;
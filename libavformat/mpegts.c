@@ -91,6 +91,7 @@ struct MpegTSFilter {
     int es_id;
     int last_cc; /* last cc code (-1 if first packet) */
     int64_t last_pcr;
+    int discard; /* the pid is only in discarded programs */
     enum MpegTSFilterType type;
     union {
         MpegTSPESFilter pes_filter;
@@ -106,6 +107,9 @@ struct Program {
 
     /** have we found pmt for this program */
     int pmt_found;
+
+    /** discard of the AVProgram when the discarded pids were updated */
+    enum AVDiscard discard;
 };
 
 struct MpegTSContext {
@@ -154,6 +158,8 @@ struct MpegTSContext {
     /** structure to keep track of Program->pids mapping */
     unsigned int nb_prg;
     struct Program *prg;
+    /** the programs changed since the discarded pids were updated */
+    int prg_changed;
 
     int8_t crc_validity[NB_PID_MAX];
     /** filters for various streams specified by PMT + for the PAT and PMT */
@@ -281,12 +287,14 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
             ts->prg[i].nb_pids = 0;
             ts->prg[i].pmt_found = 0;
         }
+    ts->prg_changed = 1;
 }
 
 static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg = 0;
+    ts->prg_changed = 1;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -300,7 +308,9 @@ static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
     p->id = programid;
     p->nb_pids = 0;
     p->pmt_found = 0;
+    p->discard = AVDISCARD_DEFAULT;
     ts->nb_prg++;
+    ts->prg_changed = 1;
 }
 
 static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
@@ -319,6 +329,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid,
             return;
 
     p->pids[p->nb_pids++] = pid;
+    ts->prg_changed = 1;
 }
 
 static void set_pmt_found(MpegTSContext *ts, unsigned int programid)
@@ -383,6 +394,50 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+static AVProgram *find_avprogram(MpegTSContext *ts, unsigned int programid)
+{
+    int i;
+
+    for (i = 0; i < ts->stream->nb_programs; i++)
+        if (ts->stream->programs[i]->id == programid)
+            return ts->stream->programs[i];
+    return NULL;
+}
+
+/**
+ * Check whether the caller changed the discard of the programs since the
+ * discarded pids were last updated.
+ */
+static void check_programs_discard(MpegTSContext *ts)
+{
+    int i;
+
+    for (i = 0; i < ts->nb_prg && !ts->prg_changed; i++) {
+        AVProgram *prg = find_avprogram(ts, ts->prg[i].id);
+        if ((prg ? prg->discard : AVDISCARD_DEFAULT) != ts->prg[i].discard)
+            ts->prg_changed = 1;
+    }
+}
+
+/**
+ * Cache the result of discard_pid() in the filters, so that the packets of
+ * the discarded programs are dropped without looking up their pid in the
+ * programs.
+ */
+static void update_discarded_pids(MpegTSContext *ts)
+{
+    int i;
+
+    for (i = 0; i < ts->nb_prg; i++) {
+        AVProgram *prg = find_avprogram(ts, ts->prg[i].id);
+        ts->prg[i].discard = prg ? prg->discard : AVDISCARD_DEFAULT;
+    }
+    for (i = 1; i < NB_PID_MAX; i++)
+        if (ts->pids[i])
+            ts->pids[i]->discard = discard_pid(ts, i);
+    ts->prg_changed = 0;
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -460,6 +515,7 @@ static MpegTSFilter *mpegts_open_filter(MpegTSContext *ts, unsigned int pid,
     filter->es_id   = -1;
     filter->last_cc = -1;
     filter->last_pcr= -1;
+    filter->discard = pid && discard_pid(ts, pid);
 
     return filter;
 }
@@ -2246,6 +2302,25 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 static int parse_pcr(int64_t *ppcr_high, int *ppcr_low,
                      const uint8_t *packet);
 
+/**
+ * Tell if all the streams of a PES filter are discarded, in which case its
+ * packets can be dropped without parsing them.
+ */
+static int discard_pes(MpegTSFilter *tss)
+{
+    PESContext *pes = tss->u.pes_filter.opaque;
+
+    if (!pes->st || pes->st->discard != AVDISCARD_ALL ||
+        (pes->sub_st && pes->sub_st->discard != AVDISCARD_ALL))
+        return 0;
+    if (pes->state != MPEGTS_SKIP) {
+        av_buffer_unref(&pes->buffer);
+        pes->data_index = 0;
+        pes->state = MPEGTS_SKIP; /* skip until pes header */
+    }
+    return 1;
+}
+
 /* handle one TS packet */
 static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
 {
@@ -2255,16 +2330,19 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     const uint8_t *p, *p_end;
     int64_t pos;
 
+    if (ts->prg_changed)
+        update_discarded_pids(ts);
+
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if (pid && discard_pid(ts, pid))
-        return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
     if (ts->auto_guess && !tss && is_start) {
+        if (pid && discard_pid(ts, pid))
+            return 0;
         add_pes_stream(ts, pid, -1);
         tss = ts->pids[pid];
     }
-    if (!tss)
+    if (!tss || tss->discard)
         return 0;
     ts->current_pid = pid;
 
@@ -2273,6 +2351,16 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
         return 0;
     has_adaptation   = afc & 2;
     has_payload      = afc & 1;
+
+    if (tss->type == MPEGTS_PES && discard_pes(tss)) {
+        /* only keep the pcr, which can be used by the other streams */
+        int64_t pcr_h;
+        int pcr_l;
+        if (has_adaptation && parse_pcr(&pcr_h, &pcr_l, packet) == 0)
+            tss->last_pcr = pcr_h * 300 + pcr_l;
+        tss->last_cc = -1;
+        return 0;
+    }
     is_discontinuity = has_adaptation &&
                        packet[4] != 0 && /* with length > 0 */
                        (packet[5] & 0x80); /* and discontinuity indicated */
@@ -2424,7 +2512,7 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
+    int ret;
     uint64_t pos = avio_tell(pb);
 
     avio_seek(pb, -FFMIN(seekback, pos), SEEK_CUR);
@@ -2435,15 +2523,12 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
         return 0;
     }
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            avio_seek(pb, -1, SEEK_CUR);
-            reanalyze(s->priv_data);
-            return 0;
-        }
+    ret = ffio_skip_to_byte(pb, 0x47, ts->resync_size);
+    if (ret < 0)
+        return ret;
+    if (ret < ts->resync_size) {
+        reanalyze(s->priv_data);
+        return 0;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -2513,6 +2598,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    check_programs_discard(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -73,6 +73,9 @@ enum {
     MPEGTS_SERVICE_TYPE_ADVANCED_CODEC_DIGITAL_HDTV  = 0x19,
     MPEGTS_SERVICE_TYPE_HEVC_DIGITAL_HDTV            = 0x1F,
 };
+/* number of TS packets of a PES packet written at once when possible */
+#define TS_BATCH_PACKETS 64
+
 typedef struct MpegTSWrite {
     const AVClass *av_class;
     MpegTSSection pat; /* MPEG-2 PAT table */
@@ -115,6 +118,8 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    uint8_t batch_buf[TS_BATCH_PACKETS * TS_PACKET_SIZE];
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -1054,6 +1059,25 @@ static void retransmit_si_info(AVFormatContext *s, int force_pat, int64_t dts)
     }
 }
 
+/* Number of packets which can be written before the SDT or the PAT have to
+ * be retransmitted, if dts does not change. */
+static int si_packets_left(MpegTSWrite *ts, int64_t dts)
+{
+    int left = INT_MAX;
+
+    if (dts != AV_NOPTS_VALUE &&
+        (ts->last_sdt_ts == AV_NOPTS_VALUE ||
+         dts - ts->last_sdt_ts >= ts->sdt_period*90000.0 ||
+         ts->last_pat_ts == AV_NOPTS_VALUE ||
+         dts - ts->last_pat_ts >= ts->pat_period*90000.0))
+        return 0;
+    if (ts->sdt_packet_count < ts->sdt_packet_period)
+        left = FFMIN(left, ts->sdt_packet_period - ts->sdt_packet_count - 1);
+    if (ts->pat_packet_count < ts->pat_packet_period)
+        left = FFMIN(left, ts->pat_packet_period - ts->pat_packet_count - 1);
+    return left;
+}
+
 static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 {
     int64_t pcr_low = pcr % 300, pcr_high = pcr / 300;
@@ -1161,6 +1185,37 @@ static uint8_t *get_ts_payload_start(uint8_t *pkt)
         return pkt + 4;
 }
 
+/*
+ * Write full TS packets without adaptation field, continuing a PES packet,
+ * batched in a single buffer.
+ */
+static void mpegts_write_pes_payload(AVFormatContext *s, MpegTSWriteStream *ts_st,
+                                     const uint8_t *payload, int nb_packets)
+{
+    MpegTSWrite *ts = s->priv_data;
+    uint8_t pid_hi = ts_st->pid >> 8, pid_lo = ts_st->pid;
+
+    ts->sdt_packet_count += nb_packets;
+    ts->pat_packet_count += nb_packets;
+    while (nb_packets > 0) {
+        int i, n = FFMIN(nb_packets, TS_BATCH_PACKETS);
+        uint8_t *q = ts->batch_buf;
+
+        for (i = 0; i < n; i++) {
+            ts_st->cc = ts_st->cc + 1 & 0xf;
+            q[0] = 0x47;
+            q[1] = pid_hi;
+            q[2] = pid_lo;
+            q[3] = 0x10 | ts_st->cc;
+            memcpy(q + 4, payload, TS_PACKET_SIZE - 4);
+            payload += TS_PACKET_SIZE - 4;
+            q       += TS_PACKET_SIZE;
+        }
+        avio_write(s->pb, ts->batch_buf, n * TS_PACKET_SIZE);
+        nb_packets -= n;
+    }
+}
+
 /* Add a PES header to the front of the payload, and segment into an integer
  * number of TS packets. The final TS packet is padded using an oversized
  * adaptation header to exactly fill the last TS packet.
@@ -1185,7 +1240,21 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     }
 
     is_start = 1;
+    is_dvb_subtitle = 0;
     while (payload_size > 0) {
+        /* Without CBR padding, the packets following the PES header only
+         * need a header, until the tables have to be retransmitted. */
+        if (!is_start && ts->mux_rate <= 1 && !ts->m2ts_mode && !is_dvb_subtitle) {
+            int nb_packets = FFMIN(payload_size / (TS_PACKET_SIZE - 4),
+                                   si_packets_left(ts, dts));
+            if (nb_packets > 0) {
+                mpegts_write_pes_payload(s, ts_st, payload, nb_packets);
+                payload      += nb_packets * (TS_PACKET_SIZE - 4);
+                payload_size -= nb_packets * (TS_PACKET_SIZE - 4);
+                continue;
+            }
+        }
+
         retransmit_si_info(s, force_pat, dts);
         force_pat = 0;
 
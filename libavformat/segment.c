@@ -38,6 +38,8 @@
 #include "libavutil/avstring.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 #include "libavutil/timecode.h"
 #include "libavutil/time_internal.h"
@@ -66,6 +68,19 @@ typedef enum {
 #define SEGMENT_LIST_FLAG_CACHE 1
 #define SEGMENT_LIST_FLAG_LIVE  2
 
+/* work for the background thread of the segment_async mode */
+typedef struct SegmentJob {
+    AVFormatContext *avf;     ///< segment to finish, NULL if none
+    SegmentListEntry entry;   ///< list entry of the segment to finish
+    int segment_count;        ///< number of segments written before it
+    int next_idx;             ///< index of the segment to open, -1 to stop
+} SegmentJob;
+
+typedef struct SegmentJobResult {
+    int ret;
+    AVFormatContext *avf;     ///< opened segment, with its header written
+} SegmentJobResult;
+
 typedef struct SegmentContext {
     const AVClass *class;  /**< Class for private options. */
     int segment_idx;       ///< index of the segment file to write, starting from 0
@@ -124,6 +139,15 @@ typedef struct SegmentContext {
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
+
+    int async;             ///< open and close the segments in a background thread
+#if HAVE_THREADS
+    pthread_t io_thread;
+    int io_thread_started;
+    int io_job_pending;    ///< a job has been sent, its result not received yet
+    AVThreadMessageQueue *io_jobs;
+    AVThreadMessageQueue *io_results;
+#endif
 } SegmentContext;
 
 static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
@@ -142,17 +166,17 @@ static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
         avio_w8(ctx, '"');
 }
 
-static int segment_mux_init(AVFormatContext *s)
+static int segment_mux_init(AVFormatContext *s, AVFormatContext **poc)
 {
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc;
     int i;
     int ret;
 
-    ret = avformat_alloc_output_context2(&seg->avf, seg->oformat, NULL, NULL);
+    ret = avformat_alloc_output_context2(poc, seg->oformat, NULL, NULL);
     if (ret < 0)
         return ret;
-    oc = seg->avf;
+    oc = *poc;
 
     oc->interrupt_callback = s->interrupt_callback;
     oc->max_delay          = s->max_delay;
@@ -186,12 +210,31 @@ static int segment_mux_init(AVFormatContext *s)
     return 0;
 }
 
-static int set_segment_filename(AVFormatContext *s)
+/* copy the name of the current segment in the list entry */
+static int set_entry_filename(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc = seg->avf;
     size_t size;
     int ret;
+
+    size = strlen(av_basename(oc->url)) + 1;
+    if (seg->entry_prefix)
+        size += strlen(seg->entry_prefix);
+
+    if ((ret = av_reallocp(&seg->cur_entry.filename, size)) < 0)
+        return ret;
+    snprintf(seg->cur_entry.filename, size, "%s%s",
+             seg->entry_prefix ? seg->entry_prefix : "",
+             av_basename(oc->url));
+
+    return 0;
+}
+
+static int set_segment_filename(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = seg->avf;
     char buf[1024];
     char *new_name;
 
@@ -216,16 +259,34 @@ static int set_segment_filename(AVFormatContext *s)
         return AVERROR(ENOMEM);
     ff_format_set_url(oc, new_name);
 
-    /* copy modified name in list entry */
-    size = strlen(av_basename(oc->url)) + 1;
-    if (seg->entry_prefix)
-        size += strlen(seg->entry_prefix);
+    return set_entry_filename(s);
+}
 
-    if ((ret = av_reallocp(&seg->cur_entry.filename, size)) < 0)
-        return ret;
-    snprintf(seg->cur_entry.filename, size, "%s%s",
-             seg->entry_prefix ? seg->entry_prefix : "",
-             av_basename(oc->url));
+/* open the file of a segment, and write its header if requested */
+static int segment_open(AVFormatContext *s, AVFormatContext *oc, int write_header)
+{
+    SegmentContext *seg = s->priv_data;
+    int err;
+
+    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
+        return err;
+    }
+    if (!seg->individual_header_trailer)
+        oc->pb->seekable = 0;
+
+    if (oc->oformat->priv_class && oc->priv_data)
+        av_opt_set(oc->priv_data, "mpegts_flags", "+resend_headers", 0);
+
+    if (write_header) {
+        AVDictionary *options = NULL;
+        av_dict_copy(&options, seg->format_options, 0);
+        av_dict_set(&options, "fflags", "-autobsf", 0);
+        err = avformat_write_header(oc, &options);
+        av_dict_free(&options);
+        if (err < 0)
+            return err;
+    }
 
     return 0;
 }
@@ -239,7 +300,7 @@ static int segment_start(AVFormatContext *s, int write_header)
     if (write_header) {
         avformat_free_context(oc);
         seg->avf = NULL;
-        if ((err = segment_mux_init(s)) < 0)
+        if ((err = segment_mux_init(s, &seg->avf)) < 0)
             return err;
         oc = seg->avf;
     }
@@ -251,25 +312,8 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
-        av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
+    if ((err = segment_open(s, oc, write_header)) < 0)
         return err;
-    }
-    if (!seg->individual_header_trailer)
-        oc->pb->seekable = 0;
-
-    if (oc->oformat->priv_class && oc->priv_data)
-        av_opt_set(oc->priv_data, "mpegts_flags", "+resend_headers", 0);
-
-    if (write_header) {
-        AVDictionary *options = NULL;
-        av_dict_copy(&options, seg->format_options, 0);
-        av_dict_set(&options, "fflags", "-autobsf", 0);
-        err = avformat_write_header(oc, &options);
-        av_dict_free(&options);
-        if (err < 0)
-            return err;
-    }
 
     seg->segment_frame_count = 0;
     return 0;
@@ -345,6 +389,52 @@ static void segment_list_print_entry(AVIOContext      *list_ioctx,
     }
 }
 
+/* add an ended segment to the list */
+static int segment_list_update(AVFormatContext *s, const SegmentListEntry *cur_entry,
+                               int segment_count, int is_last)
+{
+    SegmentContext *seg = s->priv_data;
+    int ret;
+
+    if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
+        SegmentListEntry *entry = av_mallocz(sizeof(*entry));
+        if (!entry)
+            return AVERROR(ENOMEM);
+
+        /* append new element */
+        memcpy(entry, cur_entry, sizeof(*entry));
+        entry->filename = av_strdup(entry->filename);
+        if (!seg->segment_list_entries)
+            seg->segment_list_entries = seg->segment_list_entries_end = entry;
+        else
+            seg->segment_list_entries_end->next = entry;
+        seg->segment_list_entries_end = entry;
+
+        /* drop first item */
+        if (seg->list_size && segment_count >= seg->list_size) {
+            entry = seg->segment_list_entries;
+            seg->segment_list_entries = seg->segment_list_entries->next;
+            av_freep(&entry->filename);
+            av_freep(&entry);
+        }
+
+        if ((ret = segment_list_open(s)) < 0)
+            return ret;
+        for (entry = seg->segment_list_entries; entry; entry = entry->next)
+            segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
+        if (seg->list_type == LIST_TYPE_M3U8 && is_last)
+            avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
+        ff_format_io_close(s, &seg->list_pb);
+        if (seg->use_rename)
+            ff_rename(seg->temp_list_filename, seg->list, s);
+    } else {
+        segment_list_print_entry(seg->list_pb, seg->list_type, cur_entry, s);
+        avio_flush(seg->list_pb);
+    }
+
+    return 0;
+}
+
 static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
 {
     SegmentContext *seg = s->priv_data;
@@ -369,43 +459,9 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                oc->url);
 
     if (seg->list) {
-        if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
-            SegmentListEntry *entry = av_mallocz(sizeof(*entry));
-            if (!entry) {
-                ret = AVERROR(ENOMEM);
-                goto end;
-            }
-
-            /* append new element */
-            memcpy(entry, &seg->cur_entry, sizeof(*entry));
-            entry->filename = av_strdup(entry->filename);
-            if (!seg->segment_list_entries)
-                seg->segment_list_entries = seg->segment_list_entries_end = entry;
-            else
-                seg->segment_list_entries_end->next = entry;
-            seg->segment_list_entries_end = entry;
-
-            /* drop first item */
-            if (seg->list_size && seg->segment_count >= seg->list_size) {
-                entry = seg->segment_list_entries;
-                seg->segment_list_entries = seg->segment_list_entries->next;
-                av_freep(&entry->filename);
-                av_freep(&entry);
-            }
-
-            if ((ret = segment_list_open(s)) < 0)
-                goto end;
-            for (entry = seg->segment_list_entries; entry; entry = entry->next)
-                segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
-            if (seg->list_type == LIST_TYPE_M3U8 && is_last)
-                avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            ff_format_io_close(s, &seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
-        } else {
-            segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
-            avio_flush(seg->list_pb);
-        }
+        ret = segment_list_update(s, &seg->cur_entry, seg->segment_count, is_last);
+        if (ret < 0)
+            goto end;
     }
 
     av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
@@ -441,6 +497,230 @@ end:
     return ret;
 }
 
+#if HAVE_THREADS
+/* finish a segment from the background thread, and add it to the list */
+static int segment_finish(AVFormatContext *s, SegmentJob *job)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = job->avf;
+    int ret, err;
+
+    av_write_frame(oc, NULL); /* Flush any buffered data (fragmented mp4) */
+    ret = av_write_trailer(oc);
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
+               oc->url);
+    ff_format_io_close(oc, &oc->pb);
+    avformat_free_context(oc);
+    job->avf = NULL;
+
+    if (seg->list) {
+        err = segment_list_update(s, &job->entry, job->segment_count, 0);
+        if (err < 0)
+            ret = err;
+    }
+    av_freep(&job->entry.filename);
+
+    return ret;
+}
+
+/* create the segment of the given index and write its header */
+static int segment_open_next(AVFormatContext *s, int idx, AVFormatContext **poc)
+{
+    char buf[1024];
+    char *new_name;
+    int ret;
+
+    if ((ret = segment_mux_init(s, poc)) < 0)
+        goto fail;
+
+    if (av_get_frame_filename(buf, sizeof(buf), s->url, idx) < 0) {
+        av_log(s, AV_LOG_ERROR, "Invalid segment filename template '%s'\n", s->url);
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+    new_name = av_strdup(buf);
+    if (!new_name) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ff_format_set_url(*poc, new_name);
+
+    if ((ret = segment_open(s, *poc, 1)) < 0)
+        goto fail;
+
+    return 0;
+fail:
+    if (*poc)
+        ff_format_io_close(*poc, &(*poc)->pb);
+    avformat_free_context(*poc);
+    *poc = NULL;
+    return ret;
+}
+
+static void *segment_io_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    SegmentContext *seg = s->priv_data;
+    SegmentJob job;
+    SegmentJobResult res;
+
+    while (av_thread_message_queue_recv(seg->io_jobs, &job, 0) >= 0) {
+        res.ret = 0;
+        res.avf = NULL;
+
+        if (job.avf)
+            res.ret = segment_finish(s, &job);
+        if (job.next_idx < 0)
+            break;
+        if (res.ret >= 0)
+            res.ret = segment_open_next(s, job.next_idx, &res.avf);
+
+        if (av_thread_message_queue_send(seg->io_results, &res, 0) < 0) {
+            if (res.avf)
+                ff_format_io_close(res.avf, &res.avf->pb);
+            avformat_free_context(res.avf);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int segment_next_idx(SegmentContext *seg)
+{
+    int idx = seg->segment_idx + 1;
+    return seg->segment_idx_wrap ? idx % seg->segment_idx_wrap : idx;
+}
+
+/* start the background thread, and the opening of the second segment */
+static int segment_async_start(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentJob job = { .next_idx = segment_next_idx(seg) };
+    int ret;
+
+    if ((ret = av_thread_message_queue_alloc(&seg->io_jobs, 2, sizeof(SegmentJob))) < 0 ||
+        (ret = av_thread_message_queue_alloc(&seg->io_results, 2, sizeof(SegmentJobResult))) < 0)
+        goto fail;
+
+    ret = pthread_create(&seg->io_thread, NULL, segment_io_thread, s);
+    if (ret) {
+        av_log(s, AV_LOG_ERROR, "Failed to start the segment thread: %s\n", av_err2str(AVERROR(ret)));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    seg->io_thread_started = 1;
+
+    if ((ret = av_thread_message_queue_send(seg->io_jobs, &job, 0)) < 0)
+        return ret;
+    seg->io_job_pending = 1;
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&seg->io_jobs);
+    av_thread_message_queue_free(&seg->io_results);
+    return ret;
+}
+
+/* switch to the segment opened ahead of time, and have the current one finished */
+static int segment_switch(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentJob job = { 0 };
+    SegmentJobResult res;
+    int ret;
+
+    if (!seg->io_job_pending)
+        return AVERROR(EINVAL);
+
+    job.entry = seg->cur_entry;
+    job.entry.filename = av_strdup(seg->cur_entry.filename);
+    if (!job.entry.filename)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_recv(seg->io_results, &res, 0);
+    seg->io_job_pending = 0;
+    if (ret >= 0)
+        ret = res.ret;
+    if (ret < 0) {
+        av_freep(&job.entry.filename);
+        return ret;
+    }
+
+    job.avf = seg->avf;
+    job.segment_count = seg->segment_count;
+    av_log(s, AV_LOG_VERBOSE, "segment:'%s' count:%d ended\n",
+           seg->avf->url, seg->segment_count);
+    seg->segment_count++;
+
+    seg->avf = res.avf;
+    seg->segment_idx++;
+    if ((seg->segment_idx_wrap) && (seg->segment_idx % seg->segment_idx_wrap == 0))
+        seg->segment_idx_wrap_nb++;
+    if (seg->segment_idx_wrap)
+        seg->segment_idx %= seg->segment_idx_wrap;
+    seg->segment_frame_count = 0;
+
+    job.next_idx = segment_next_idx(seg);
+    if ((ret = av_thread_message_queue_send(seg->io_jobs, &job, 0)) < 0) {
+        segment_finish(s, &job);
+        return ret;
+    }
+    seg->io_job_pending = 1;
+
+    return set_entry_filename(s);
+}
+
+/* stop the background thread, after it is done with the previous segment */
+static int segment_async_stop(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    SegmentJob job = { .next_idx = -1 };
+    SegmentJobResult res;
+    int ret = 0;
+
+    if (!seg->io_thread_started)
+        return 0;
+
+    if (seg->io_job_pending) {
+        seg->io_job_pending = 0;
+        if (av_thread_message_queue_recv(seg->io_results, &res, 0) >= 0) {
+            ret = res.ret;
+            /* the segment opened ahead of time is not needed */
+            if (res.avf) {
+                ff_format_io_close(res.avf, &res.avf->pb);
+                avpriv_io_delete(res.avf->url);
+                avformat_free_context(res.avf);
+            }
+        }
+    }
+
+    av_thread_message_queue_send(seg->io_jobs, &job, 0);
+    pthread_join(seg->io_thread, NULL);
+    seg->io_thread_started = 0;
+    av_thread_message_queue_free(&seg->io_jobs);
+    av_thread_message_queue_free(&seg->io_results);
+
+    return ret;
+}
+#else
+static int segment_async_start(AVFormatContext *s)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int segment_switch(AVFormatContext *s)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int segment_async_stop(AVFormatContext *s)
+{
+    return 0;
+}
+#endif
+
 static int parse_times(void *log_ctx, int64_t **times, int *nb_times,
                        const char *times_str)
 {
@@ -638,6 +918,7 @@ static int select_reference_stream(AVFormatContext *s)
 static void seg_free(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
+    segment_async_stop(s);
     ff_format_io_close(seg->avf, &seg->list_pb);
     avformat_free_context(seg->avf);
     seg->avf = NULL;
@@ -660,6 +941,24 @@ static int seg_init(AVFormatContext *s)
         seg->individual_header_trailer = 0;
     }
 
+    if (seg->async) {
+        const char *reason = NULL;
+        if (!HAVE_THREADS)
+            reason = "threads are not available";
+        else if (!seg->individual_header_trailer)
+            reason = "individual_header_trailer is disabled";
+        else if (seg->use_strftime)
+            reason = "strftime is enabled";
+        else if (seg->increment_tc)
+            reason = "increment_tc is enabled";
+        else if (seg->segment_idx_wrap)
+            reason = "segment_wrap is set";
+        if (reason) {
+            av_log(s, AV_LOG_WARNING, "segment_async ignored, %s\n", reason);
+            seg->async = 0;
+        }
+    }
+
     if (seg->initial_offset > 0) {
         av_log(s, AV_LOG_WARNING, "NOTE: the option initial_offset is deprecated,"
                "you can use output_ts_offset instead of it\n");
@@ -742,7 +1041,7 @@ static int seg_init(AVFormatContext *s)
         return AVERROR(EINVAL);
     }
 
-    if ((ret = segment_mux_init(s)) < 0)
+    if ((ret = segment_mux_init(s, &seg->avf)) < 0)
         return ret;
 
     if ((ret = set_segment_filename(s)) < 0)
@@ -842,6 +1141,9 @@ static int seg_write_header(AVFormatContext *s)
             oc->pb->seekable = 0;
     }
 
+    if (seg->async)
+        return segment_async_start(s);
+
     return 0;
 }
 
@@ -898,11 +1200,16 @@ calc_times:
         if (seg->cur_entry.last_duration == 0)
             seg->cur_entry.end_time = (double)pkt->pts * av_q2d(st->time_base);
 
-        if ((ret = segment_end(s, seg->individual_header_trailer, 0)) < 0)
-            goto fail;
+        if (seg->async) {
+            if ((ret = segment_switch(s)) < 0)
+                goto fail;
+        } else {
+            if ((ret = segment_end(s, seg->individual_header_trailer, 0)) < 0)
+                goto fail;
 
-        if ((ret = segment_start(s, seg->individual_header_trailer)) < 0)
-            goto fail;
+            if ((ret = segment_start(s, seg->individual_header_trailer)) < 0)
+                goto fail;
+        }
 
         seg->cut_pending = 0;
         seg->cur_entry.index = seg->segment_idx + seg->segment_idx_wrap * seg->segment_idx_wrap_nb;
@@ -961,11 +1268,14 @@ static int seg_write_trailer(struct AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     AVFormatContext *oc = seg->avf;
     SegmentListEntry *cur, *next;
-    int ret = 0;
+    int ret = 0, err;
 
     if (!oc)
         goto fail;
 
+    /* the last segment is still written if the previous one failed */
+    err = segment_async_stop(s);
+
     if (!seg->write_header_trailer) {
         if ((ret = segment_end(s, 0, 1)) < 0)
             goto fail;
@@ -975,6 +1285,8 @@ static int seg_write_trailer(struct AVFormatContext *s)
         close_null_ctxp(&oc->pb);
     } else {
         ret = segment_end(s, 1, 1);
+        if (err < 0)
+            ret = err;
     }
 fail:
     if (seg->list)
@@ -1061,6 +1373,7 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the beginning of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "segment_async", "open the next segment ahead of time and finish the previous one in a background thread", OFFSET(async), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { NULL },
 };
 
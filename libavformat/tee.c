@@ -119,6 +119,39 @@ static int parse_slave_fifo_options(const char *use_fifo,
     return ret;
 }
 
+/* queue_size and onfull are shortcuts for the fifo options of the slave */
+static int parse_slave_queue_options(const char *queue_size, const char *on_full,
+                                     TeeSlave *tee_slave)
+{
+    int ret, drop;
+
+    if (queue_size) {
+        ret = av_dict_set(&tee_slave->fifo_options, "queue_size", queue_size, 0);
+        if (ret < 0)
+            return ret;
+        tee_slave->use_fifo = 1;
+    }
+
+    if (on_full) {
+        if (!strcmp(on_full, "block")) {
+            drop = 0;
+        } else if (!strcmp(on_full, "drop")) {
+            drop = 1;
+        } else {
+            return AVERROR(EINVAL);
+        }
+        /* resume on a keyframe after dropping, so that the output stays decodable */
+        if ((ret = av_dict_set(&tee_slave->fifo_options, "drop_pkts_on_overflow",
+                               drop ? "1" : "0", 0)) < 0 ||
+            (ret = av_dict_set(&tee_slave->fifo_options, "restart_with_keyframe",
+                               drop ? "1" : "0", 0)) < 0)
+            return ret;
+        tee_slave->use_fifo = 1;
+    }
+
+    return 0;
+}
+
 static int close_slave(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
@@ -164,6 +197,7 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     char *filename;
     char *format = NULL, *select = NULL, *on_fail = NULL;
     char *use_fifo = NULL, *fifo_options_str = NULL;
+    char *queue_size = NULL, *on_full = NULL;
     AVFormatContext *avf2 = NULL;
     AVStream *st, *st2;
     int stream_count;
@@ -186,6 +220,8 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
     STEAL_OPTION("onfail", on_fail);
     STEAL_OPTION("use_fifo", use_fifo);
     STEAL_OPTION("fifo_options", fifo_options_str);
+    STEAL_OPTION("queue_size", queue_size);
+    STEAL_OPTION("onfull", on_full);
 
     ret = parse_slave_failure_policy_option(on_fail, tee_slave);
     if (ret < 0) {
@@ -200,6 +236,13 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
         goto end;
     }
 
+    ret = parse_slave_queue_options(queue_size, on_full, tee_slave);
+    if (ret < 0) {
+        av_log(avf, AV_LOG_ERROR,
+               "Invalid queue_size or onfull option value, valid onfull options are 'block' and 'drop'\n");
+        goto end;
+    }
+
     if (tee_slave->use_fifo) {
 
         if (options) {
@@ -397,6 +440,10 @@ end:
     av_free(format);
     av_free(select);
     av_free(on_fail);
+    av_free(use_fifo);
+    av_free(fifo_options_str);
+    av_free(queue_size);
+    av_free(on_full);
     av_dict_free(&options);
     av_freep(&tmp_select);
     return ret;
@@ -538,11 +585,21 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
     TeeContext *tee = avf->priv_data;
     AVFormatContext *avf2;
     AVBSFContext *bsfs;
-    AVPacket pkt2;
+    AVPacket pkt2, pkt_ref;
     int ret_all = 0, ret;
     unsigned i, s;
     int s2;
 
+    /* make the packet refcounted once, so that all the slaves share its data */
+    av_init_packet(&pkt_ref);
+    pkt_ref.data = NULL;
+    pkt_ref.size = 0;
+    if (pkt && !pkt->buf) {
+        if ((ret = av_packet_ref(&pkt_ref, pkt)) < 0)
+            return ret;
+        pkt = &pkt_ref;
+    }
+
     for (i = 0; i < tee->nb_slaves; i++) {
         if (!(avf2 = tee->slaves[i].avf))
             continue;
@@ -564,11 +621,11 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
             continue;
 
         memset(&pkt2, 0, sizeof(AVPacket));
-        if ((ret = av_packet_ref(&pkt2, pkt)) < 0)
-            if (!ret_all) {
+        if ((ret = av_packet_ref(&pkt2, pkt)) < 0) {
+            if (!ret_all)
                 ret_all = ret;
-                continue;
-            }
+            continue;
+        }
         bsfs = tee->slaves[i].bsfs[s2];
         pkt2.stream_index = s2;
 
@@ -603,6 +660,7 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
                 ret_all = ret;
         }
     }
+    av_packet_unref(&pkt_ref);
     return ret_all;
 }
 
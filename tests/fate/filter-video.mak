@@ -117,6 +117,24 @@ FATE_FILTER-$(call ALLYES, FRAMERATE_FILTER TESTSRC2_FILTER FORMAT_FILTER) += fa
 fate-filter-framerate-12bit-up: CMD = framecrc -lavfi testsrc2=r=50:d=1,format=pix_fmts=yuv422p12le,framerate=fps=60 -t 1 -pix_fmt yuv422p12le
 fate-filter-framerate-12bit-down: CMD = framecrc -lavfi testsrc2=r=60:d=1,format=pix_fmts=yuv422p12le,framerate=fps=50 -t 1 -pix_fmt yuv422p12le
 
+FATE_FILTER-$(call ALLYES, MOSAIC_FILTER TESTSRC2_FILTER SMPTEBARS_FILTER RGBTESTSRC_FILTER) += fate-filter-mosaic
+fate-filter-mosaic: CMD = framecrc -lavfi "testsrc2=s=320x240:r=5:d=1[a];smptebars=s=160x120:r=5:d=1[b];rgbtestsrc=s=64x64:r=5:d=1[c];[a][b][c]mosaic=inputs=3:size=320x240:layout=0_0_240_180|240_0_80_60|240_60_80_80:fill=blue:flags=bilinear+accurate_rnd+bitexact" -pix_fmt yuv420p
+
+# the cells have the size of the input, so that they are filled by exact copies
+SPRITESHEET_GRAPH = testsrc2=s=64x36:r=25:d=2,spritesheet=layout=3x2:s=64x36:interval=0.2:margin=2:padding=2:color=red
+
+FATE_FILTER-$(call ALLYES, SPRITESHEET_FILTER TESTSRC2_FILTER) += fate-filter-spritesheet
+fate-filter-spritesheet: CMD = framecrc -lavfi "$(SPRITESHEET_GRAPH)"
+
+FATE_FILTER-$(call ALLYES, SPRITESHEET_FILTER TESTSRC2_FILTER NULL_MUXER) += fate-filter-spritesheet-vtt
+fate-filter-spritesheet-vtt: CMD = ffmpeg -lavfi "$(SPRITESHEET_GRAPH):vtt=-:pattern=thumb%02d.jpg" -f null -
+
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER FORMAT_FILTER SPLIT_FILTER BOXBLUR_FILTER HFLIP_FILTER NEGATE_FILTER VFLIP_FILTER EDGEDETECT_FILTER HSTACK_FILTER) += fate-filter-parallel fate-filter-parallel-4
+FILTER_PARALLEL_GRAPH = "testsrc2=s=160x120:r=5:d=2,format=yuv420p,split=3[a][b][c];[a]boxblur=2:1[a1];[b]hflip,negate[b1];[c]vflip,edgedetect[c1];[a1][b1][c1]hstack=3"
+fate-filter-parallel: CMD = framecrc -filter_complex_threads 1 -lavfi $(FILTER_PARALLEL_GRAPH)
+fate-filter-parallel-4: CMD = framecrc -filter_parallel -filter_complex_threads 4 -lavfi $(FILTER_PARALLEL_GRAPH)
+fate-filter-parallel-4: REF = $(SRC_PATH)/tests/ref/fate/filter-parallel
+
 FATE_FILTER_VSYNTH-$(CONFIG_BOXBLUR_FILTER) += fate-filter-boxblur
 fate-filter-boxblur: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf boxblur=2:1
 
@@ -711,6 +729,23 @@ FATE_METADATA_FILTER-$(call ALLYES, $(SCENEDETECT_DEPS)) += fate-filter-metadata
 fate-filter-metadata-scenedetect: SRC = $(TARGET_SAMPLES)/svq3/Vertical400kbit.sorenson3.mov
 fate-filter-metadata-scenedetect: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;movie='$(SRC)',select=gt(scene\,.4)"
 
+SCENEHIST_DEPS = FFPROBE LAVFI_INDEV AVDEVICE TESTSRC2_FILTER SMPTEBARS_FILTER \
+                 CONCAT_FILTER SELECT_FILTER SCALE_FILTER
+FATE_FILTER_FFPROBE-$(call ALLYES, $(SCENEHIST_DEPS)) += fate-filter-metadata-scenedetect-hist
+fate-filter-metadata-scenedetect-hist: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;testsrc2=s=320x240:d=0.2[a];smptebars=s=320x240:d=0.2[b];[a][b]concat,select=gte(scene_hist\,0)[out0]"
+
+MOTIONDETECT_DEPS = FFPROBE LAVFI_INDEV AVDEVICE TESTSRC2_FILTER MOTIONDETECT_FILTER SCALE_FILTER
+FATE_FILTER_FFPROBE-$(call ALLYES, $(MOTIONDETECT_DEPS)) += fate-filter-metadata-motiondetect
+fate-filter-metadata-motiondetect: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;testsrc2=s=320x240:d=0.4,motiondetect=zones=0_0_160_240|160_0_160_240[out0]"
+
+FATE_FILTER_FFPROBE-$(call ALLYES, $(MOTIONDETECT_DEPS)) += fate-filter-metadata-motiondetect-factor2
+fate-filter-metadata-motiondetect-factor2: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;testsrc2=s=320x240:d=0.4,motiondetect=factor=2:threshold=24[out0]"
+
+HEALTHDETECT_DEPS = FFPROBE LAVFI_INDEV AVDEVICE TESTSRC2_FILTER COLOR_FILTER SMPTEBARS_FILTER \
+                    CONCAT_FILTER HEALTHDETECT_FILTER SCALE_FILTER
+FATE_FILTER_FFPROBE-$(call ALLYES, $(HEALTHDETECT_DEPS)) += fate-filter-metadata-healthdetect
+fate-filter-metadata-healthdetect: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;testsrc2=s=160x120:d=0.4[a];color=black:s=160x120:d=0.6[b];smptebars=s=160x120:d=0.6[c];testsrc2=s=160x120:d=0.4[d];[a][b][c][d]concat=n=4,healthdetect=d=0.2[out0]"
+
 CROPDETECT_DEPS = FFPROBE LAVFI_INDEV MOVIE_FILTER CROPDETECT_FILTER SCALE_FILTER \
                   AVCODEC AVDEVICE MOV_DEMUXER H264_DECODER
 FATE_METADATA_FILTER-$(call ALLYES, $(CROPDETECT_DEPS)) += fate-filter-metadata-cropdetect
@@ -769,9 +804,10 @@ FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-re
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
+FATE_FFPROBE += $(FATE_FILTER_FFPROBE-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
 
 fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_SAMPLES-yes) $(FATE_FILTER_VSYNTH-yes)
 
-fate-filter: fate-afilter fate-vfilter $(FATE_METADATA_FILTER-yes)
+fate-filter: fate-afilter fate-vfilter $(FATE_METADATA_FILTER-yes) $(FATE_FILTER_FFPROBE-yes)
@@ -23,10 +23,35 @@ FATE_MOV_FFPROBE = fate-mov-aac-2048-priming \
                    fate-mov-guess-delay-2 \
                    fate-mov-guess-delay-3 \
 
+# faststart with a reserved moov atom: the moov atom of this file is 617
+# bytes. It fits in a predicted reservation with room for a free atom,
+# fills a moov_size of 617 exactly, fits in 620 bytes but leaves no room
+# for a free atom (the data is moved by 5 bytes), and does not fit in 600
+# bytes (the data is moved by 33 bytes). The last test checks that the
+# predicted reservation is capped to 64 MiB.
+FATE_MOV_FASTSTART = fate-mov-faststart-duration \
+                     fate-mov-faststart-moov-size-exact \
+                     fate-mov-faststart-moov-size-barely-fits \
+                     fate-mov-faststart-moov-size-too-small \
+                     fate-mov-faststart-duration-cap \
+
+$(FATE_MOV_FASTSTART): tests/data/asynth-44100-2.wav
+$(FATE_MOV_FASTSTART): CMD = transcode wav tests/data/asynth-44100-2.wav mov \
+                             "-t 0.5 -c:a pcm_s16le -fflags +bitexact -movflags +faststart $(FASTSTART_OPTS)" "-c copy"
+
+fate-mov-faststart-duration:               FASTSTART_OPTS = -faststart_duration 10
+fate-mov-faststart-moov-size-exact:        FASTSTART_OPTS = -moov_size 617
+fate-mov-faststart-moov-size-barely-fits:  FASTSTART_OPTS = -moov_size 620
+fate-mov-faststart-moov-size-too-small:    FASTSTART_OPTS = -moov_size 600
+fate-mov-faststart-duration-cap:           FASTSTART_OPTS = -faststart_duration 100000000
+
+FATE_FFMPEG-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER PCM_S16LE_ENCODER \
+                          MOV_MUXER MOV_DEMUXER) += $(FATE_MOV_FASTSTART)
+
 FATE_SAMPLES_AVCONV += $(FATE_MOV)
 FATE_SAMPLES_FFPROBE += $(FATE_MOV_FFPROBE)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE)
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART)
 
 # Make sure we handle edit lists correctly in normal cases.
 fate-mov-1elist-noctts: CMD = framemd5 -i $(TARGET_SAMPLES)/mov/mov-1elist-noctts.mov
@@ -11,4 +11,17 @@ fate-mpegts-probe-latm: CMD = run $(PROBE_CODEC_NAME_COMMAND) -i "$(SRC)"
 
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+#
+# Test muxing PES packets spanning many TS packets, written in batches
+# between the PAT/PMT and SDT retransmissions
+#
+MPEGTS_MUX_INPUTS = -f lavfi -i testsrc2=s=160x120:r=25:d=2 -f lavfi -i sine=d=2 \
+                    -c:v rawvideo -c:a pcm_s16be -flags +bitexact -fflags +bitexact
+
+FATE_MPEGTS_MUX-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER RAWVIDEO_ENCODER PCM_S16BE_ENCODER MPEGTS_MUXER MD5_PROTOCOL) += fate-mpegts-mux-batch fate-mpegts-mux-batch-period
+fate-mpegts-mux-batch:        CMD = md5pipe $(MPEGTS_MUX_INPUTS) -f mpegts
+fate-mpegts-mux-batch-period: CMD = md5pipe $(MPEGTS_MUX_INPUTS) -pat_period 0.1 -sdt_period 0.3 -f mpegts
+
+FATE_FFMPEG += $(FATE_MPEGTS_MUX-yes)
+
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS_MUX-yes)
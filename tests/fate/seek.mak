@@ -257,14 +257,58 @@ fate-seek-extra-mp4:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES
 fate-seek-cache-pipe: CMD = cat $(TARGET_SAMPLES)/gapless/gapless.mp3 | run libavformat/tests/seek$(EXESUF) cache:pipe:0 -read_ahead_limit -1
 fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mkv/codec_delay_opus.mkv
 
+FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-extra-mp4-lazy_index
+fate-seek-extra-mp4-lazy_index: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/buck480p30_na.mp4 -duration 180 -frames 4 -lazy_index 1
+fate-seek-extra-mp4-lazy_index: REF = $(SRC_PATH)/tests/ref/seek/extra-mp4
+
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
+# a file without Cues, large enough to seek by bisection on the clusters,
+# which start with a CRC-32 element
+tests/data/mkv-nocues.mkv: TAG = GEN
+tests/data/mkv-nocues.mkv: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin -f lavfi -i testsrc2=s=160x120:r=25:d=12 \
+	-c:v rawvideo -fflags +bitexact -live 1 -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_SEEK_LAVFI-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER RAWVIDEO_ENCODER MATROSKA_MUXER MATROSKA_DEMUXER) += fate-seek-mkv-nocues
+fate-seek-mkv-nocues: tests/data/mkv-nocues.mkv
+fate-seek-mkv-nocues: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mkv-nocues.mkv -duration 12 -frames 1
+
+# a fragmented file whose first fragment is in the moov, followed by its mdat
+tests/data/mov-frag.mov: TAG = GEN
+tests/data/mov-frag.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin -f lavfi -i testsrc2=s=160x120:r=25:d=10 \
+	-f lavfi -i sine=d=10:r=22050 -c:v mpeg4 -qscale:v 4 -g 25 -threads 1 -c:a pcm_s16le \
+	-flags +bitexact -fflags +bitexact -movflags frag_keyframe -f mov -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_SEEK_LAVFI-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER MPEG4_ENCODER PCM_S16LE_ENCODER MOV_MUXER MOV_DEMUXER) += fate-seek-mov-frag fate-seek-mov-frag-lazy_fragments
+fate-seek-mov-frag fate-seek-mov-frag-lazy_fragments: tests/data/mov-frag.mov
+fate-seek-mov-frag:                CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov-frag.mov -duration 10 -frames 1
+fate-seek-mov-frag-lazy_fragments: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov-frag.mov -duration 10 -frames 1 -lazy_fragments 1
+fate-seek-mov-frag-lazy_fragments: REF = $(SRC_PATH)/tests/ref/seek/mov-frag
+
+FATE_SEEK_LAVFI += $(FATE_SEEK_LAVFI-yes)
+
+# the mov tests again with the index built lazily, which must seek to the
+# same packets
+FATE_SEEK_MOV-$(call ENCDEC2, MPEG4, PCM_ALAW, MOV) += lavf-mov
+FATE_SEEK_MOV-$(call ENCDEC,  ALAC,            MOV) += acodec-alac
+FATE_SEEK_MOV-$(call ENCDEC,  PCM_S16BE,       MOV) += acodec-pcm-s16be
+
+FATE_SEEK_MOV = $(FATE_SEEK_MOV-yes:%=fate-seek-%-lazy_index)
+$(FATE_SEEK_MOV): fate-seek-%-lazy_index: fate-%
+$(FATE_SEEK_MOV): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC) -lazy_index 1
+$(FATE_SEEK_MOV): REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%-lazy_index=%)
+fate-seek-lavf-mov-lazy_index:         SRC = lavf/lavf.mov
+fate-seek-acodec-alac-lazy_index:      SRC = fate/acodec-alac.mov
+fate-seek-acodec-pcm-s16be-lazy_index: SRC = fate/acodec-pcm-s16be.mov
+
 
-$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_LAVFI) $(FATE_SEEK_MOV): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_LAVFI) $(FATE_SEEK_MOV)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_LAVFI) $(FATE_SEEK_MOV)
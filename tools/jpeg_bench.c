@@ -0,0 +1,288 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the MJPEG encoding time of thumbnails with the regular and the
+ * fast encoder paths: the time per frame when encoding a sequence with one
+ * encoder, and the time per thumbnail when an encoder is opened and closed
+ * for each of them.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include "libavformat/avformat.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "libswscale/swscale.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define MAX_FRAMES 1000
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: jpeg_bench [-n frames] [-q qscale] [-s size] [-r runs] file\n"
+            "    -n frames  number of frames of the file to encode (default 100)\n"
+            "    -q qscale  constant quantizer (default 5)\n"
+            "    -s size    size of the thumbnails (default the size of the file)\n"
+            "    -r runs    number of runs, the fastest is kept (default 5)\n"
+            );
+    exit(ret);
+}
+
+static int read_frames(const char *filename, int width, int height,
+                       AVFrame **frames, int nb_frames)
+{
+    AVFormatContext *avf = NULL;
+    AVCodecContext *dec = NULL;
+    struct SwsContext *sws = NULL;
+    AVCodec *codec;
+    AVPacket pkt;
+    AVFrame *frame = av_frame_alloc();
+    int ret, stream, n = 0;
+
+    av_init_packet(&pkt);
+    if (!frame)
+        return AVERROR(ENOMEM);
+    if ((ret = avformat_open_input(&avf, filename, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(avf, NULL)) < 0 ||
+        (ret = av_find_best_stream(avf, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0)
+        goto end;
+    stream = ret;
+
+    dec = avcodec_alloc_context3(codec);
+    if (!dec) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(dec, avf->streams[stream]->codecpar)) < 0 ||
+        (ret = avcodec_open2(dec, codec, NULL)) < 0)
+        goto end;
+
+    while (n < nb_frames) {
+        ret = avcodec_receive_frame(dec, frame);
+        if (ret == AVERROR(EAGAIN)) {
+            ret = av_read_frame(avf, &pkt);
+            if (ret == AVERROR_EOF) {
+                ret = avcodec_send_packet(dec, NULL);
+            } else if (ret >= 0) {
+                if (pkt.stream_index == stream)
+                    ret = avcodec_send_packet(dec, &pkt);
+                av_packet_unref(&pkt);
+            }
+            if (ret < 0)
+                goto end;
+            continue;
+        }
+        if (ret < 0)
+            break;
+
+        sws = sws_getCachedContext(sws, frame->width, frame->height, frame->format,
+                                   width  ? width  : frame->width,
+                                   height ? height : frame->height,
+                                   AV_PIX_FMT_YUVJ420P, SWS_BICUBIC, NULL, NULL, NULL);
+        frames[n] = av_frame_alloc();
+        if (!sws || !frames[n]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        frames[n]->width  = width  ? width  : frame->width;
+        frames[n]->height = height ? height : frame->height;
+        frames[n]->format = AV_PIX_FMT_YUVJ420P;
+        if ((ret = av_frame_get_buffer(frames[n], 32)) < 0)
+            goto end;
+        sws_scale(sws, (const uint8_t * const *)frame->data, frame->linesize,
+                  0, frame->height, frames[n]->data, frames[n]->linesize);
+        av_frame_unref(frame);
+        n++;
+    }
+    ret = n;
+
+end:
+    sws_freeContext(sws);
+    av_frame_free(&frame);
+    avcodec_free_context(&dec);
+    avformat_close_input(&avf);
+    return ret;
+}
+
+static int open_encoder(AVCodecContext **enc, AVCodec *codec, const AVFrame *frame,
+                        int qscale, int fast)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    *enc = avcodec_alloc_context3(codec);
+    if (!*enc)
+        return AVERROR(ENOMEM);
+    (*enc)->width          = frame->width;
+    (*enc)->height         = frame->height;
+    (*enc)->pix_fmt        = frame->format;
+    (*enc)->time_base      = (AVRational){ 1, 25 };
+    (*enc)->flags         |= AV_CODEC_FLAG_QSCALE;
+    (*enc)->global_quality = qscale * FF_QP2LAMBDA;
+    av_dict_set_int(&opts, "fast", fast, 0);
+    ret = avcodec_open2(*enc, codec, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static int encode(AVCodecContext *enc, AVFrame *frame, AVPacket *pkt)
+{
+    int ret;
+
+    frame->quality = enc->global_quality;
+    if ((ret = avcodec_send_frame(enc, frame)) < 0 ||
+        (ret = avcodec_receive_packet(enc, pkt)) < 0)
+        return ret;
+    av_packet_unref(pkt);
+    return 0;
+}
+
+/* encode all the frames with one encoder, return the time taken */
+static int64_t bench_sequence(AVCodec *codec, AVFrame **frames, int nb_frames,
+                              int qscale, int fast)
+{
+    AVCodecContext *enc = NULL;
+    AVPacket pkt;
+    int64_t t0, t1;
+    int i, ret;
+
+    av_init_packet(&pkt);
+    if ((ret = open_encoder(&enc, codec, frames[0], qscale, fast)) < 0)
+        goto end;
+    t0 = av_gettime_relative();
+    for (i = 0; i < nb_frames; i++)
+        if ((ret = encode(enc, frames[i], &pkt)) < 0)
+            goto end;
+    t1 = av_gettime_relative();
+    ret = 0;
+
+end:
+    avcodec_free_context(&enc);
+    return ret < 0 ? ret : t1 - t0;
+}
+
+/* open an encoder for each frame, return the time taken */
+static int64_t bench_thumbnails(AVCodec *codec, AVFrame **frames, int nb_frames,
+                                int qscale, int fast)
+{
+    AVCodecContext *enc = NULL;
+    AVPacket pkt;
+    int64_t t0;
+    int i, ret;
+
+    av_init_packet(&pkt);
+    t0 = av_gettime_relative();
+    for (i = 0; i < nb_frames; i++) {
+        if ((ret = open_encoder(&enc, codec, frames[i], qscale, fast)) < 0 ||
+            (ret = encode(enc, frames[i], &pkt)) < 0)
+            break;
+        avcodec_free_context(&enc);
+    }
+    avcodec_free_context(&enc);
+    return ret < 0 ? ret : av_gettime_relative() - t0;
+}
+
+int main(int argc, char **argv)
+{
+    int opt, ret = 0, i, fast, run;
+    int nb_frames = 100, qscale = 5, width = 0, height = 0, nb_runs = 5;
+    AVFrame *frames[MAX_FRAMES] = { NULL };
+    AVCodec *codec;
+
+    while ((opt = getopt(argc, argv, "hn:q:s:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nb_frames = atoi(optarg);
+            break;
+        case 'q':
+            qscale = atoi(optarg);
+            break;
+        case 's':
+            if (av_parse_video_size(&width, &height, optarg) < 0)
+                usage(1);
+            break;
+        case 'r':
+            nb_runs = atoi(optarg);
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1 || nb_frames <= 0 || nb_frames > MAX_FRAMES || nb_runs <= 0)
+        usage(1);
+
+    av_register_all();
+    av_log_set_level(AV_LOG_ERROR);
+    codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        fprintf(stderr, "no MJPEG encoder\n");
+        return 1;
+    }
+
+    ret = read_frames(argv[0], width, height, frames, nb_frames);
+    if (ret <= 0) {
+        fprintf(stderr, "%s: could not read frames: %s\n", argv[0],
+                av_err2str(ret ? ret : AVERROR_EOF));
+        ret = AVERROR_EOF;
+        goto end;
+    }
+    nb_frames = ret;
+
+    printf("%s: %d frames of %dx%d, qscale %d, best of %d runs\n", argv[0],
+           nb_frames, frames[0]->width, frames[0]->height, qscale, nb_runs);
+    for (fast = 0; fast <= 1; fast++) {
+        int64_t seq = INT64_MAX, thumb = INT64_MAX, t;
+
+        for (run = 0; run < nb_runs; run++) {
+            t = bench_sequence(codec, frames, nb_frames, qscale, fast);
+            if (t < 0)
+                goto fail;
+            seq = FFMIN(seq, t);
+            t = bench_thumbnails(codec, frames, nb_frames, qscale, fast);
+            if (t < 0)
+                goto fail;
+            thumb = FFMIN(thumb, t);
+            continue;
+fail:
+            fprintf(stderr, "encoding failed: %s\n", av_err2str(t));
+            ret = t;
+            goto end;
+        }
+        printf("%-8s sequence: %8.1f us/frame, thumbnails: %8.1f us/thumbnail\n",
+               fast ? "fast" : "regular", (double)seq / nb_frames,
+               (double)thumb / nb_frames);
+    }
+    ret = 0;
+
+end:
+    for (i = 0; i < MAX_FRAMES; i++)
+        av_frame_free(&frames[i]);
+    return ret < 0;
+}
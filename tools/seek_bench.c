@@ -0,0 +1,197 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the latency of seeking in a video stream: the time spent in
+ * avcodec_flush_buffers() and the time until the first frame after the
+ * seek is returned by the decoder.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+
+#include "libavformat/avformat.h"
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: seek_bench [-n seeks] [-t threads] [-s thread_type] file\n"
+            "    -n seeks        number of random seeks (default 100)\n"
+            "    -t threads      number of decoding threads (default 1)\n"
+            "    -s thread_type  'frame' or 'slice' (default frame)\n"
+            );
+    exit(ret);
+}
+
+static int decode_first_frame(AVFormatContext *avf, AVCodecContext *dec,
+                              int stream, AVPacket *pkt, AVFrame *frame)
+{
+    int ret;
+
+    while (1) {
+        ret = avcodec_receive_frame(dec, frame);
+        if (ret >= 0) {
+            av_frame_unref(frame);
+            return 0;
+        }
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        ret = av_read_frame(avf, pkt);
+        if (ret == AVERROR_EOF) {
+            ret = avcodec_send_packet(dec, NULL);
+        } else if (ret >= 0) {
+            if (pkt->stream_index == stream)
+                ret = avcodec_send_packet(dec, pkt);
+            av_packet_unref(pkt);
+        }
+        if (ret < 0)
+            return ret;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int opt, ret, stream, i, nb_seeks = 100, threads = 1;
+    int thread_type = FF_THREAD_FRAME;
+    const char *filename;
+    AVFormatContext *avf = NULL;
+    AVCodecContext *dec = NULL;
+    AVCodec *codec;
+    AVStream *st;
+    AVPacket pkt;
+    AVFrame *frame = NULL;
+    AVLFG lfg;
+    int64_t t0, t1, t2, flush_total = 0, first_total = 0, first_max = 0;
+
+    while ((opt = getopt(argc, argv, "hn:t:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nb_seeks = atoi(optarg);
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 's':
+            if (!strcmp(optarg, "slice"))
+                thread_type = FF_THREAD_SLICE;
+            else if (!strcmp(optarg, "frame"))
+                thread_type = FF_THREAD_FRAME;
+            else
+                usage(1);
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc != 1 || nb_seeks <= 0)
+        usage(1);
+    filename = argv[0];
+
+    av_register_all();
+    av_init_packet(&pkt);
+    av_lfg_init(&lfg, 0x5eec);
+
+    if ((ret = avformat_open_input(&avf, filename, NULL, NULL)) < 0) {
+        fprintf(stderr, "%s: %s\n", filename, av_err2str(ret));
+        return 1;
+    }
+    if ((ret = avformat_find_stream_info(avf, NULL)) < 0) {
+        fprintf(stderr, "%s: could not find codec parameters: %s\n", filename,
+                av_err2str(ret));
+        goto end;
+    }
+    ret = av_find_best_stream(avf, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (ret < 0) {
+        fprintf(stderr, "%s: no decodable video stream\n", filename);
+        goto end;
+    }
+    stream = ret;
+    st     = avf->streams[stream];
+
+    dec   = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    if (!dec || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(dec, st->codecpar)) < 0)
+        goto end;
+    dec->thread_count = threads;
+    dec->thread_type  = thread_type;
+    if ((ret = avcodec_open2(dec, codec, NULL)) < 0) {
+        fprintf(stderr, "%s: could not open decoder: %s\n", filename,
+                av_err2str(ret));
+        goto end;
+    }
+
+    /* warm up the decoder */
+    if ((ret = decode_first_frame(avf, dec, stream, &pkt, frame)) < 0)
+        goto end;
+
+    for (i = 0; i < nb_seeks; i++) {
+        int64_t ts = avf->duration > 0 ?
+                     av_lfg_get(&lfg) % avf->duration + FFMAX(avf->start_time, 0) :
+                     0;
+
+        ret = avformat_seek_file(avf, -1, INT64_MIN, ts, ts, 0);
+        if (ret < 0) {
+            fprintf(stderr, "seek to %"PRId64" failed: %s\n", ts, av_err2str(ret));
+            goto end;
+        }
+
+        t0 = av_gettime_relative();
+        avcodec_flush_buffers(dec);
+        t1 = av_gettime_relative();
+        ret = decode_first_frame(avf, dec, stream, &pkt, frame);
+        t2 = av_gettime_relative();
+        if (ret < 0 && ret != AVERROR_EOF) {
+            fprintf(stderr, "decoding failed: %s\n", av_err2str(ret));
+            goto end;
+        }
+
+        flush_total += t1 - t0;
+        first_total += t2 - t1;
+        first_max    = FFMAX(first_max, t2 - t1);
+    }
+
+    printf("%s: %s, %d thread(s), %d seeks\n", filename, codec->name,
+           dec->thread_count, nb_seeks);
+    printf("flush:       %8.1f us avg\n", (double)flush_total / nb_seeks);
+    printf("first frame: %8.1f us avg, %8"PRId64" us max\n",
+           (double)first_total / nb_seeks, first_max);
+    ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&dec);
+    avformat_close_input(&avf);
+    return ret < 0;
+}